@@ -1,64 +1,456 @@
+// Brainfuck interpreter
+// Source is parsed once into an intermediate representation (IR) with precomputed
+// jump targets, run-length folded + - < > and recognised idioms: [-] clears a cell,
+// copy/multiply loops like [->+>++<<] become one op. Then a tight loop runs the IR.
+// Semantics: 8-bit wrapping cells, data pointer stops at both ends of the data,
+// ',' leaves the cell unchanged on EOF or newline.
+// Optional x86-64 JIT (-j) translates the same IR to machine code.
+// Compile: gcc -std=gnu17 -Wall -O3 brainfuck.c
+// Usage  : ./a.out [-j] prog.b  |  ./a.out [-j] < prog.b  |  ./a.out [-j] (type program)
+
 #include <stdio.h>
-#include <stdlib.h>  // malloc, free
+#include <stdlib.h>  // malloc, realloc, free
+#include <stdint.h>  // int32_t, uint8_t
+#include <stdbool.h> // bool
+#include <string.h>  // memcpy, strcmp
 #include <unistd.h>  // isatty, fileno
 
+#if defined(__x86_64__) && defined(__GNUC__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+    #define BF_JIT 1
+    #include <sys/mman.h>  // mmap, mprotect, munmap
+    #ifndef MAP_ANONYMOUS
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+#else
+    #define BF_JIT 0
+#endif
+
 #define DATASIZE 32768  // reserved data size
 #define CODESIZE  1024  // initial code size
+#define MAXDEPTH  4096  // maximum bracket nesting
+
+typedef enum opcode {
+    OP_ADD,    // data[dp] += arg
+    OP_RIGHT,  // dp += arg, stop at end of data
+    OP_LEFT,   // dp -= arg, stop at start of data
+    OP_OUT,    // output data[dp]
+    OP_IN,     // input to data[dp]
+    OP_JZ,     // if !data[dp]: ip = arg (one past matching OP_JNZ)
+    OP_JNZ,    // if data[dp]: ip = arg (one past matching OP_JZ)
+    OP_CLEAR,  // data[dp] = 0
+    OP_MUL,    // arg = number of OP_TERM that follow, off/val = min/max offset on loop path
+    OP_TERM,   // data[dp + off] += data[dp] * arg (part of OP_MUL)
+    OP_END
+} OpCode;
 
-static char data[DATASIZE];
+typedef struct op {
+    int32_t code;
+    int32_t arg;
+    int32_t off;
+    int32_t val;
+} Op;
+
+static uint8_t data[DATASIZE];
 static char *code;
 static size_t codesize, codelen;
-static size_t ip, dp;  // instruction pointer, data pointer
+static Op *prog;
+static size_t progsize, proglen;
 
-// Read from stdin until stop character and check for pangram.
-static size_t read_until(const int stop)
+// Read from file until stop character, store in code.
+static size_t read_until(FILE *f, const int stop)
 {
     int c;
     size_t i = 0;
-    while ((c = fgetc(stdin)) != stop) {
-        //
+    while ((c = fgetc(f)) != EOF && c != stop) {
+        if (i == codesize) {
+            char *tmp = realloc(code, (codesize <<= 1) * sizeof *code);
+            if (!tmp)
+                break;
+            code = tmp;
+        }
+        code[i++] = (char)c;
     }
     return i;
 }
 
+static bool emit(const OpCode opcode, const int32_t arg, const int32_t off, const int32_t val)
+{
+    if (proglen == progsize) {
+        const size_t size = progsize ? progsize << 1 : CODESIZE;
+        Op *tmp = realloc(prog, size * sizeof *tmp);
+        if (!tmp)
+            return false;
+        prog = tmp;
+        progsize = size;
+    }
+    prog[proglen++] = (Op){opcode, arg, off, val};
+    return true;
+}
+
+// Recognise loop body between code[i] = '[' and code[j] = ']' as copy/multiply loop:
+// only + - < >, net movement zero, cell 0 changes by -1 or +1 per iteration.
+// On success, emit OP_MUL and terms. The regular loop stays behind it as fallback
+// for when the loop path would hit the end of the data (where moves stop).
+static bool mulloop(const size_t i, const size_t j, int *delta0)
+{
+    int32_t pos = 0, minpos = 0, maxpos = 0;
+    int32_t off[64], fac[64];
+    int n = 0;
+    for (size_t k = i + 1; k < j; ++k) {
+        const char c = code[k];
+        if (c == '>' || c == '<') {
+            pos += c == '>' ? 1 : -1;
+            if (pos < minpos) minpos = pos;
+            if (pos > maxpos) maxpos = pos;
+        } else if (c == '+' || c == '-') {
+            int t = 0;
+            while (t < n && off[t] != pos)
+                ++t;
+            if (t == n) {
+                if (n == 64)
+                    return false;
+                off[n] = pos;
+                fac[n++] = 0;
+            }
+            fac[t] += c == '+' ? 1 : -1;
+        } else if (c == '[' || c == ']' || c == '.' || c == ',')
+            return false;
+    }
+    if (pos)
+        return false;
+    *delta0 = 0;
+    int terms = 0;
+    for (int t = 0; t < n; ++t)
+        if (!off[t])
+            *delta0 = fac[t] & 0xff;
+        else if (fac[t] & 0xff)
+            ++terms;
+    if (*delta0 != 0xff && *delta0 != 1)
+        return false;
+    if (!terms && !minpos && !maxpos)  // [-] or [+]
+        return emit(OP_CLEAR, 0, 0, 0);
+    if (!emit(OP_MUL, terms, minpos, maxpos))
+        return false;
+    for (int t = 0; t < n; ++t)
+        if (off[t] && (fac[t] & 0xff))
+            // for delta +1 the number of iterations is -data[dp], so negate factor
+            if (!emit(OP_TERM, *delta0 == 1 ? -fac[t] : fac[t], off[t], 0))
+                return false;
+    return true;
+}
+
+// Translate code to IR; false if brackets don't match or out of memory
+static bool parse(void)
+{
+    size_t stack[MAXDEPTH], depth = 0;
+    for (size_t i = 0; i < codelen; ++i) {
+        const char c = code[i];
+        switch (c) {
+            case '+': case '-': {
+                int sum = 0;
+                for (; i < codelen; ++i) {
+                    if (code[i] == '+') sum++;
+                    else if (code[i] == '-') sum--;
+                    else if (code[i] == '<' || code[i] == '>' || code[i] == '[' || code[i] == ']' || code[i] == '.' || code[i] == ',') break;
+                }
+                --i;
+                if ((sum & 0xff) && !emit(OP_ADD, sum & 0xff, 0, 0))
+                    return false;
+                break;
+            }
+            case '<': case '>': {
+                int32_t n = 0;
+                for (; i < codelen && code[i] == c; ++i)
+                    ++n;
+                --i;
+                if (!emit(c == '>' ? OP_RIGHT : OP_LEFT, n, 0, 0))
+                    return false;
+                break;
+            }
+            case '.': if (!emit(OP_OUT, 0, 0, 0)) return false; break;
+            case ',': if (!emit(OP_IN , 0, 0, 0)) return false; break;
+            case '[': {
+                // Find matching bracket to try idioms
+                size_t j = i + 1;
+                for (int level = 1; j < codelen; ++j)
+                    if (code[j] == '[') ++level;
+                    else if (code[j] == ']' && !--level) break;
+                if (j == codelen) {
+                    fprintf(stderr, "Unmatched '[' at %zu\n", i);
+                    return false;
+                }
+                int delta0;
+                const size_t start = proglen;
+                if (mulloop(i, j, &delta0) && prog[start].code == OP_CLEAR) {
+                    i = j;  // clear loop replaced entirely
+                    break;
+                }
+                if (depth == MAXDEPTH) {
+                    fprintf(stderr, "Nesting too deep at %zu\n", i);
+                    return false;
+                }
+                stack[depth++] = proglen;
+                if (!emit(OP_JZ, 0, 0, 0))
+                    return false;
+                break;
+            }
+            case ']': {
+                if (!depth) {
+                    fprintf(stderr, "Unmatched ']' at %zu\n", i);
+                    return false;
+                }
+                const size_t open = stack[--depth];
+                if (!emit(OP_JNZ, (int32_t)(open + 1), 0, 0))
+                    return false;
+                prog[open].arg = (int32_t)proglen;
+                break;
+            }
+        }
+    }
+    return emit(OP_END, 0, 0, 0);
+}
+
+static void run(void)
+{
+    size_t dp = 0;
+    for (const Op *ip = prog; ; ++ip) {
+        int c;
+        switch (ip->code) {
+            case OP_ADD: data[dp] += (uint8_t)ip->arg; break;
+            case OP_RIGHT: dp = dp + (size_t)ip->arg < DATASIZE ? dp + (size_t)ip->arg : DATASIZE - 1; break;
+            case OP_LEFT: dp = dp > (size_t)ip->arg ? dp - (size_t)ip->arg : 0; break;
+            case OP_OUT: putchar(data[dp]); break;
+            case OP_IN:
+                if ((c = getchar()) != EOF && c != '\n')
+                    data[dp] = (uint8_t)c;
+                break;
+            case OP_JZ: if (!data[dp]) ip = prog + ip->arg - 1; break;
+            case OP_JNZ: if (data[dp]) ip = prog + ip->arg - 1; break;
+            case OP_CLEAR: data[dp] = 0; break;
+            case OP_MUL:
+                // Only if the loop path stays inside the data, else run regular loop
+                if (data[dp] && (int64_t)dp + ip->off >= 0 && (int64_t)dp + ip->val < DATASIZE) {
+                    const uint8_t x = data[dp];
+                    for (int32_t t = 1; t <= ip->arg; ++t)
+                        data[dp + (size_t)(int64_t)ip[t].off] += (uint8_t)(x * ip[t].arg);
+                    data[dp] = 0;
+                }
+                ip += ip->arg;
+                break;
+            case OP_END: return;
+        }
+    }
+}
+
+#if BF_JIT
+// x86-64 JIT: same IR, same semantics. Registers: rbx = data, r12 = dp.
+// I/O goes through the helpers below, called via absolute address in rax.
+// Code is written to an anonymous mapping which is then made executable (W^X).
+
+static void jit_out(int c)
+{
+    putchar(c);
+}
+
+static int jit_in(int old)
+{
+    const int c = getchar();
+    return c != EOF && c != '\n' ? c : old;
+}
+
+typedef struct jitbuf {
+    uint8_t *mem;
+    size_t len;
+} JitBuf;
+
+static void put(JitBuf *b, const void *bytes, const size_t n)
+{
+    memcpy(b->mem + b->len, bytes, n);
+    b->len += n;
+}
+
+static void put32(JitBuf *b, const int32_t x)
+{
+    put(b, &x, sizeof x);
+}
+
+static void put64(JitBuf *b, const uint64_t x)
+{
+    put(b, &x, sizeof x);
+}
+
+static void patch32(JitBuf *b, const size_t at, const size_t target)
+{
+    const int32_t rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+    memcpy(b->mem + at, &rel, sizeof rel);
+}
+
+#define CELL 0x04, 0x23  // ModRM/SIB for [rbx + r12], needs REX.X
+
+static void callhelper(JitBuf *b, void *func)
+{
+    put(b, (uint8_t[]){0x48, 0xb8}, 2);           // mov rax, imm64
+    put64(b, (uint64_t)(uintptr_t)func);
+    put(b, (uint8_t[]){0xff, 0xd0}, 2);           // call rax
+}
+
+typedef void (*jitfunc_t)(uint8_t *);
+
+// Translate IR to machine code; returns NULL if not possible
+static jitfunc_t compile(size_t *size)
+{
+    const size_t cap = 64 * proglen + 64;
+    JitBuf b = {mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0), 0};
+    size_t *addr = malloc((proglen + 1) * sizeof *addr);  // code offset of each op
+    size_t *jpos = malloc((proglen + 1) * sizeof *jpos);  // offset of rel32 of each jump
+    if (b.mem == MAP_FAILED || !addr || !jpos) {
+        if (b.mem != MAP_FAILED)
+            munmap(b.mem, cap);
+        free(addr);
+        free(jpos);
+        return NULL;
+    }
+
+    // Prologue: push rbx, r12, r13 (keeps stack 16-byte aligned for calls); rbx = data; r12 = 0
+    put(&b, (uint8_t[]){0x53, 0x41, 0x54, 0x41, 0x55, 0x48, 0x89, 0xfb, 0x4d, 0x31, 0xe4}, 11);
+    for (size_t i = 0; i < proglen; ++i) {
+        const Op *op = &prog[i];
+        addr[i] = b.len;
+        switch (op->code) {
+            case OP_ADD:    // add byte [rbx+r12], imm8
+                put(&b, (uint8_t[]){0x42, 0x80, CELL, (uint8_t)op->arg}, 5);
+                break;
+            case OP_RIGHT:  // add r12, imm32; mov eax, DATASIZE-1; cmp r12, rax; cmova r12, rax
+                put(&b, (uint8_t[]){0x49, 0x81, 0xc4}, 3);
+                put32(&b, op->arg);
+                put(&b, (uint8_t[]){0xb8}, 1);
+                put32(&b, DATASIZE - 1);
+                put(&b, (uint8_t[]){0x49, 0x39, 0xc4, 0x4c, 0x0f, 0x47, 0xe0}, 7);
+                break;
+            case OP_LEFT:   // xor eax, eax; sub r12, imm32; cmovb r12, rax
+                put(&b, (uint8_t[]){0x31, 0xc0, 0x49, 0x81, 0xec}, 5);
+                put32(&b, op->arg);
+                put(&b, (uint8_t[]){0x4c, 0x0f, 0x42, 0xe0}, 4);
+                break;
+            case OP_OUT:    // movzx edi, byte [rbx+r12]; call jit_out
+                put(&b, (uint8_t[]){0x42, 0x0f, 0xb6, 0x3c, 0x23}, 5);
+                callhelper(&b, (void *)jit_out);
+                break;
+            case OP_IN:     // movzx edi, byte [rbx+r12]; call jit_in; mov [rbx+r12], al
+                put(&b, (uint8_t[]){0x42, 0x0f, 0xb6, 0x3c, 0x23}, 5);
+                callhelper(&b, (void *)jit_in);
+                put(&b, (uint8_t[]){0x42, 0x88, CELL}, 4);
+                break;
+            case OP_JZ:     // cmp byte [rbx+r12], 0; je rel32
+            case OP_JNZ:    // cmp byte [rbx+r12], 0; jne rel32
+                put(&b, (uint8_t[]){0x42, 0x80, 0x3c, 0x23, 0x00, 0x0f, op->code == OP_JZ ? 0x84 : 0x85}, 7);
+                jpos[i] = b.len;
+                put32(&b, 0);
+                break;
+            case OP_CLEAR:  // mov byte [rbx+r12], 0
+                put(&b, (uint8_t[]){0x42, 0xc6, CELL, 0x00}, 5);
+                break;
+            case OP_MUL: {
+                // movzx eax, byte [rbx+r12]; test eax, eax; jz skip
+                put(&b, (uint8_t[]){0x42, 0x0f, 0xb6, CELL, 0x85, 0xc0, 0x0f, 0x84}, 9);
+                const size_t j1 = b.len;
+                put32(&b, 0);
+                // cmp r12, -minoff; jb skip; cmp r12, DATASIZE-maxoff; jae skip
+                put(&b, (uint8_t[]){0x49, 0x81, 0xfc}, 3);
+                put32(&b, -op->off);
+                put(&b, (uint8_t[]){0x0f, 0x82}, 2);
+                const size_t j2 = b.len;
+                put32(&b, 0);
+                put(&b, (uint8_t[]){0x49, 0x81, 0xfc}, 3);
+                put32(&b, DATASIZE - op->val);
+                put(&b, (uint8_t[]){0x0f, 0x83}, 2);
+                const size_t j3 = b.len;
+                put32(&b, 0);
+                for (int32_t t = 1; t <= op->arg; ++t) {
+                    // imul edx, eax, imm32; add byte [rbx+r12+disp32], dl
+                    put(&b, (uint8_t[]){0x69, 0xd0}, 2);
+                    put32(&b, op[t].arg);
+                    put(&b, (uint8_t[]){0x42, 0x00, 0x94, 0x23}, 4);
+                    put32(&b, op[t].off);
+                    addr[i + (size_t)t] = b.len;
+                }
+                put(&b, (uint8_t[]){0x42, 0xc6, CELL, 0x00}, 5);
+                patch32(&b, j1, b.len);
+                patch32(&b, j2, b.len);
+                patch32(&b, j3, b.len);
+                i += (size_t)op->arg;
+                break;
+            }
+            case OP_TERM:   // only inside OP_MUL
+                break;
+            case OP_END:    // pop r13, r12, rbx; ret
+                put(&b, (uint8_t[]){0x41, 0x5d, 0x41, 0x5c, 0x5b, 0xc3}, 6);
+                break;
+        }
+    }
+    for (size_t i = 0; i < proglen; ++i)
+        if (prog[i].code == OP_JZ || prog[i].code == OP_JNZ)
+            patch32(&b, jpos[i], addr[prog[i].arg]);
+    free(addr);
+    free(jpos);
+
+    if (mprotect(b.mem, cap, PROT_READ | PROT_EXEC)) {
+        munmap(b.mem, cap);
+        return NULL;
+    }
+    *size = cap;
+    jitfunc_t func;
+    memcpy(&func, &b.mem, sizeof func);  // object pointer to function pointer
+    return func;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
-    code = malloc(CODESIZE * sizeof *code);
+    const bool usejit = argc > 1 && !strcmp(argv[1], "-j");
+    if (usejit) {
+        argc--;
+        argv++;
+    }
+    code = malloc((codesize = CODESIZE) * sizeof *code);
     if (!code)
         return 1;
-    if (!isatty(fileno(stdin))) {
+    if (argc > 1) {
+        // Program file on command line.
+        FILE *f = fopen(argv[1], "r");
+        if (!f) {
+            perror(argv[1]);
+            return 1;
+        }
+        codelen = read_until(f, EOF);
+        fclose(f);
+    } else if (!isatty(fileno(stdin))) {
         // Input is pipe or redirect to stdin of this program.
-        codelen = read_until(EOF);
-    } else if (argc > 1) {
-        // Command line arguments.
+        codelen = read_until(stdin, EOF);
     } else {
         // Manual input.
         printf("? ");
-        codelen = read_until('\n');
+        codelen = read_until(stdin, '\n');
     }
-    while (ip < codelen) {
-        int c;
-        switch (code[ip]) {
-            case '+': data[dp]++;                   break;
-            case ',':
-                if ((c = fgetc(stdin)) != EOF && c != '\n')
-                    data[dp] = c & 0xff;
-                break;
-            case '-': data[dp]--;                   break;
-            case '.': fputc(data[dp], stdout);      break;
-            case '<': if (dp) dp--;                 break;
-            case '>': if (dp != DATASIZE - 1) dp++; break;
-            case '[': // TODO: brackets can be nested
-                if (!data[dp])
-                    while (ip < codelen && code[ip] != ']')
-                        ++ip;
-                break;
-            case ']':
-                if (data[dp])
-                    while (ip && code[ip] != '[')
-                        --ip;
-                break;
-        }
+    if (!parse())
+        return 2;
+#if BF_JIT
+    size_t jitsize = 0;
+    jitfunc_t jitfunc = usejit ? compile(&jitsize) : NULL;
+    if (jitfunc) {
+        jitfunc(data);
+        void *mem;
+        memcpy(&mem, &jitfunc, sizeof mem);
+        munmap(mem, jitsize);
+    } else
+#endif
+    {
+        if (usejit)
+            fprintf(stderr, "JIT not available, using interpreter.\n");
+        run();
     }
+    fflush(stdout);
+    free(prog);
+    free(code);
     return 0;
 }
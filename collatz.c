@@ -1,23 +1,139 @@
+// Collatz delay records: n with more steps to reach 1 than any smaller n
+// Multithreaded: blocks of n are taken from a shared counter, computed in a
+// thread-local window and committed in order, so records are printed in order.
+// Shared cache of delays only for n ≡ 3 mod 4 (other n quickly drop below
+// themselves and end up at a cached odd number), 4x less memory than for all n.
+// Residue sieve mod 2^SIEVEPOW: skip n that provably merge with a smaller number
+// after the same number of steps, because then n has the same delay and is no record.
+// Jump table mod 2^JUMPPOW: advance JUMPPOW steps of (3k+1)/2 or k/2 at once.
+// Compile: gcc -std=gnu17 -Wall -O3 collatz.c -pthread
+// Usage  : ./a.out [threads [cachebits [maxn]]]
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define CACHEPOW   32                 // default: cache delays of n < 2^32
+#define BLOCKSIZE  (UINT64_C(1) << 16)  // n per work unit
+#define MAXREC     2048               // max prefix records per block (delay < 2048 for 64-bit n)
+#define MAXTHREADS 256
+#define SIEVEPOW   20                 // residue sieve modulus 2^20
+#define JUMPPOW    16                 // k-step jump table for k = 16
+#define SIEVEMASK  ((UINT64_C(1) << SIEVEPOW) - 1)
+#define JUMPMASK   ((UINT64_C(1) << JUMPPOW) - 1)
+
+typedef struct record {
+    uint64_t n;
+    uint16_t len;
+} Record;
+
+typedef struct slot {
+    uint64_t block;          // block number in this slot
+    int ready;               // 1 = result waiting to be committed
+    int count;               // prefix records in block
+    Record rec[MAXREC];
+} Slot;
 
-#define CACHEPOW 32
-#define CACHEMAX (UINT64_C(1) << CACHEPOW)
+static _Atomic uint16_t *cache;  // cache[n >> 2] = delay of n, for n ≡ 3 mod 4, 0 = unknown
+static uint64_t cachemax;
+static uint64_t maxn = UINT64_MAX;
+static atomic_uint_fast64_t nextblock;
 
-int main(void)
+static uint64_t keep[(SIEVEMASK + 1) / 64];  // bit r set = residue r mod 2^SIEVEPOW may hold a record
+static uint8_t  jumpc[JUMPMASK + 1];          // odd steps in JUMPPOW steps from residue r
+static uint32_t jumpd[JUMPMASK + 1];          // 2^k q + r  ->  3^c q + d
+static uint64_t pow3[JUMPPOW + 1];
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  freed = PTHREAD_COND_INITIALIZER;
+static Slot *slot;               // ring of nslots results waiting to be committed
+static uint64_t nslots;
+static uint64_t commitblock;     // next block to commit
+static unsigned int recnum = 1;  // record number
+static uint16_t maxlen;          // longest delay committed so far
+
+// Parity sequence of residue r mod 2^k for k steps of T(x) = x odd ? (3x+1)/2 : x/2
+// 2^k q + r  ->  3^c q + d  for every q >= 0, after k + c ordinary steps
+static uint64_t residue(const uint64_t r, const int k, int *c)
 {
-    uint16_t *cache = calloc(CACHEMAX, sizeof *cache);
-    if (!cache) {
-        fprintf(stderr, "Unable to claim 2^%d x %zu bytes of memory.\n", CACHEPOW, sizeof *cache);
-        return EXIT_FAILURE;
+    uint64_t d = r;
+    *c = 0;
+    for (int j = 0; j < k; ++j)
+        if (d & 1) {
+            d += (d >> 1) + 1;  // d = (3d+1)/2
+            ++*c;
+        } else
+            d >>= 1;
+    return d;
+}
+
+typedef struct merge {
+    uint64_t key;  // c << 40 | d
+    uint32_t r;
+} Merge;
+
+static int cmpmerge(const void *p, const void *q)
+{
+    const Merge *a = p, *b = q;
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    return a->r < b->r ? -1 : a->r > b->r;
+}
+
+// Residues with the same (c, d) merge after the same number of steps:
+// only the smallest of each group can hold a record. Returns kept fraction.
+static double makesieve(void)
+{
+    const uint64_t size = SIEVEMASK + 1;
+    Merge *m = malloc(size * sizeof *m);
+    if (!m)
+        return -1;
+    for (uint64_t r = 0; r < size; ++r) {
+        int c;
+        const uint64_t d = residue(r, SIEVEPOW, &c);
+        m[r] = (Merge){(uint64_t)c << 40 | d, (uint32_t)r};
     }
+    qsort(m, size, sizeof *m, cmpmerge);
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < size; ++i)
+        if (!i || m[i].key != m[i - 1].key) {
+            keep[m[i].r >> 6] |= UINT64_C(1) << (m[i].r & 63);
+            ++kept;
+        }
+    free(m);
 
-    puts("1 1 0");
-    uint16_t i = 1, maxlen = 0;
-    for (uint64_t n = 2; n; ++n) {
-        uint16_t len = 0;
-        for (uint64_t k = n; k > 1; ) {
+    pow3[0] = 1;
+    for (int i = 1; i <= JUMPPOW; ++i)
+        pow3[i] = 3 * pow3[i - 1];
+    for (uint64_t r = 0; r <= JUMPMASK; ++r) {
+        int c;
+        jumpd[r] = (uint32_t)residue(r, JUMPPOW, &c);
+        jumpc[r] = (uint8_t)c;
+    }
+    return (double)kept / size;
+}
+
+static inline int iskept(const uint64_t n)
+{
+    const uint64_t r = n & SIEVEMASK;
+    return n <= SIEVEMASK || (keep[r >> 6] >> (r & 63) & 1);
+}
+
+// Number of steps for n to reach 1
+static inline uint16_t delay(const uint64_t n)
+{
+    uint16_t len = 0;
+    for (uint64_t k = n; k > 1; ) {
+        if (k > JUMPMASK) {
+            // Jump JUMPPOW steps at once (can't reach 1 before the end because q >= 1)
+            const uint64_t r = k & JUMPMASK;
+            k = pow3[jumpc[r]] * (k >> JUMPPOW) + jumpd[r];
+            len += JUMPPOW + jumpc[r];
+        } else {
             while (k & 1) {  // odd
                 k += (k >> 1) + 1;  // k = (3k+1)/2
                 len += 2;
@@ -25,16 +141,128 @@ int main(void)
             const int z = __builtin_ctzll(k);
             k >>= z;
             len += z;
-            if (k < CACHEMAX && cache[k]) {
-                len += cache[k];
-                break;
+        }
+        if ((k & 3) == 3 && k < cachemax) {
+            const uint16_t c = atomic_load_explicit(&cache[k >> 2], memory_order_relaxed);
+            if (c)
+                return len + c;
+        }
+    }
+    return len;
+}
+
+// Print records of committed blocks in order; call with lock held
+static void commit(void)
+{
+    for (Slot *s; (s = &slot[commitblock % nslots])->ready && s->block == commitblock; ++commitblock) {
+        for (int i = 0; i < s->count; ++i)
+            if (s->rec[i].len > maxlen) {
+                maxlen = s->rec[i].len;
+                printf("%u %"PRIu64" %u\n", ++recnum, s->rec[i].n, maxlen);
             }
+        s->ready = 0;
+        fflush(stdout);
+    }
+    pthread_cond_broadcast(&freed);
+}
+
+static void *worker(void *arg)
+{
+    (void)arg;
+    uint64_t b;
+    while ((b = atomic_fetch_add(&nextblock, 1)) <= maxn / BLOCKSIZE) {
+        // Thread-local window: prefix records of this block
+        Record rec[MAXREC];
+        int count = 0;
+        uint16_t best = 0;
+        const uint64_t lo = b ? b * BLOCKSIZE : 2;
+        const uint64_t hi = b < maxn / BLOCKSIZE ? (b + 1) * BLOCKSIZE - 1 : maxn;
+        for (uint64_t n = lo; ; ++n) {
+            if (!iskept(n)) {
+                if (n == hi)
+                    break;
+                continue;
+            }
+            const uint16_t len = delay(n);
+            if ((n & 3) == 3 && n < cachemax)
+                atomic_store_explicit(&cache[n >> 2], len, memory_order_relaxed);
+            if (len > best && count < MAXREC) {
+                rec[count++] = (Record){n, len};
+                best = len;
+            }
+            if (n == hi)
+                break;
         }
-        if (n < CACHEMAX && !cache[n])
-            cache[n] = len;
-        if (len > maxlen)
-            printf("%u %llu %u\n", ++i, n, maxlen = len);
+
+        // Wait for free slot in ring, store result, commit what is ready
+        pthread_mutex_lock(&lock);
+        while (b >= commitblock + nslots)
+            pthread_cond_wait(&freed, &lock);
+        Slot *s = &slot[b % nslots];
+        s->block = b;
+        s->count = count;
+        for (int i = 0; i < count; ++i)
+            s->rec[i] = rec[i];
+        s->ready = 1;
+        commit();
+        pthread_mutex_unlock(&lock);
     }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN), cachepow = CACHEPOW;
+    if (argc > 1)
+        nthreads = atoi(argv[1]);
+    if (argc > 2)
+        cachepow = atoi(argv[2]);
+    if (argc > 3)
+        maxn = strtoull(argv[3], NULL, 10);
+    if (maxn < 2) {
+        fprintf(stderr, "maxn must be at least 2.\n");
+        return 1;
+    }
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAXTHREADS)
+        nthreads = MAXTHREADS;
+    if (cachepow < 2 || cachepow > 40)
+        cachepow = CACHEPOW;
+
+    // Fall back to smaller cache if memory is short
+    for (; cachepow >= 2; --cachepow) {
+        cachemax = UINT64_C(1) << cachepow;
+        if ((cache = calloc(cachemax >> 2, sizeof *cache)))
+            break;
+        fprintf(stderr, "Unable to claim 2^%d x %zu bytes of memory.\n", cachepow - 2, sizeof *cache);
+    }
+    nslots = 4 * (uint64_t)nthreads;
+    slot = calloc(nslots, sizeof *slot);
+    if (!cache || !slot) {
+        free(cache);
+        free(slot);
+        return EXIT_FAILURE;
+    }
+
+    const double kept = makesieve();
+    if (kept < 0) {
+        free(cache);
+        free(slot);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "Residue sieve mod 2^%d keeps %.2f%% of n.\n", SIEVEPOW, kept * 100);
+
+    puts("1 1 0");
+    pthread_t tid[MAXTHREADS];
+    int started = 0;
+    for (int i = 1; i < nthreads; ++i)
+        if (!pthread_create(&tid[started], NULL, worker, NULL))
+            started++;
+    worker(NULL);
+    for (int i = 0; i < started; ++i)
+        pthread_join(tid[i], NULL);
+    free(slot);
     free(cache);
     return 0;
 }
@@ -1,87 +1,157 @@
-// Testing permutation algorithms
+// Benchmark of permutation algorithms
 // There are n-factorial possible permutations of an array with n elements.
 //   10! =     3,628,800
 //   11! =    39,916,800
 //   12! =   479,001,600
 //   13! = 6,227,020,800
 //
-// Times in milliseconds:
+// For both orders (lexicographic and plain changes), times:
+//   static  : old interface with static state, one permutation per call
+//   next    : reentrant iterator, one permutation per call
+//   bulk    : reentrant iterator, copy BULK permutations per call to a buffer
+//             (pays for the copy, but no call per permutation)
+//   threads : bulk in every thread, range split by rank (permut_seek)
+// Every permutation is read (checksum) so the work can't be optimised away.
 //
-// Pi5 | count | lexic | plain |
-// ----+-------+-------+-------+
-//  10 |     9 |    30 |    23 |
-//  11 |   100 |   325 |   263 |
-//  12 |  1200 |  3927 |  3556 |
-//  13 | 15594 | 50896 | 45340 |
-//
-//  i5 | count | lexic | plain | Core i5-8250U 1.8GHz
-// ----+-------+-------+-------+
-//  10 |     5 |    20 |    37 |
-//  11 |    60 |   224 |   406 |
-//  12 |   728 |  2693 |  4945 |
-//  13 |  9507 | 35114 | 64357 |
-//
-//  M1 | count | lexic | plain |
-// ----+-------+-------+-------+
-//  10 |     7 |    15 |    10 |
-//  11 |    83 |   164 |   103 |
-//  12 |  1013 |  1977 |  1219 |
-//  13 | 13300 | 25773 | 15771 |
-//
-//  M4 | count | lexic | plain |
-// ----+-------+-------+-------+
-//  10 |     1 |     8 |     6 |
-//  11 |     9 |    96 |    73 |
-//  12 |   109 |  1165 |   883 |
-//  13 |  1580 | 15257 | 11676 |
+// Compile: gcc -std=gnu17 -Wall -O3 combperm-test.c combperm.c startstoptimer.c -pthread
+// Usage  : combperm-test [n [threads]]
+//            n       : 1..20, default 11
+//            threads : default = number of CPUs
 
 #include <stdio.h>
-#include <stdlib.h>    // atoi
-#include <string.h>    // strlen
+#include <stdlib.h>    // atoi, malloc, free
 #include <stdint.h>    // uint64_t
 #include <inttypes.h>  // PRIu64
+#include <unistd.h>    // sysconf
+#include <pthread.h>   // pthread_create, pthread_join
 #include "combperm.h"
 #include "startstoptimer.h"
 
-static int errmsg(const char *const progname, const int errval)
+#define BULK 256
+#define MAXTHREADS 256
+
+typedef struct range {
+    pthread_t tid;
+    PermutKind kind;
+    int n;
+    uint64_t start, count;  // in: range of ranks
+    uint64_t sum, done;     // out: checksum, permutations visited
+} Range;
+
+// Position-weighted sum, same for any split of the range
+static inline uint64_t checksum(const int *a, const int n)
 {
-    fprintf(stderr, "Test permutation algorithms\n");
-    fprintf(stderr, "Usage : %s p|l|c <n>\n", progname);
-    fprintf(stderr, "   p  : 'plain changes' (Steinhaus-Johnson-Trotter)\n");
-    fprintf(stderr, "   l  : lexicographic order\n");
-    fprintf(stderr, "   c  : only count to n factorial, no permutations\n");
-    fprintf(stderr, "  <n> : integer number >=1 and <=20 (practically <=13)\n");
-    return errval;
+    uint64_t s = 0;
+    for (int i = 0; i < n; ++i)
+        s += (uint64_t)(i + 1) * (uint64_t)a[i];
+    return s;
 }
 
-int main(int argc, char *argv[])
+static void *rangeworker(void *arg)
 {
-    if (argc != 3)
-        return errmsg(argv[0], 1);
-    if (strlen(argv[1]) != 1 || strlen(argv[2]) > 2)
-        return errmsg(argv[0], 2);
-    if (!strchr("plc", argv[1][0]))
-        return errmsg(argv[0], 3);
+    Range *r = arg;
+    PermutCtx *ctx = permut_new(r->kind, r->n, 0);
+    int *buf = malloc((size_t)BULK * (size_t)r->n * sizeof *buf);
+    if (ctx && buf && permut_seek(ctx, r->start))
+        for (uint64_t left = r->count; left; ) {
+            const int want = left < BULK ? (int)left : BULK;
+            const int got = permut_bulk(ctx, buf, want);
+            for (int i = 0; i < got; ++i)
+                r->sum += checksum(buf + i * r->n, r->n);
+            r->done += (uint64_t)got;
+            left -= (uint64_t)got;
+            if (got < want)
+                break;
+        }
+    free(buf);
+    permut_free(ctx);
+    return NULL;
+}
 
-    const int n = atoi(argv[2]);
-    if (n < 1 || n > 20)
-        return errmsg(argv[0], 4);
+static void report(const char *alg, const char *mode, const uint64_t count, const uint64_t sum, const double ms)
+{
+    printf("%-6s %-8s %13"PRIu64" %20"PRIu64" %9.0f %9.1f\n", alg, mode, count, sum, ms, ms > 0 ? count / ms / 1e3 : 0);
+}
 
-    uint64_t fac = 1;
-    for (int i = 2; i <= n; ++i)
-        fac *= i;
+static void bench(const PermutKind kind, const int n, const int nthreads)
+{
+    const char *alg = kind == PERMUT_LEXIC ? "lexic" : "plain";
+    uint64_t count = 0, sum = 0;
+    double ms;
 
-    const char alg = argv[1][0];
-    volatile uint64_t count = 0;
+    starttimer();
+    if (kind == PERMUT_LEXIC)
+        for (const int *a; (a = permutations(n)); ++count)
+            sum += checksum(a, n);
+    else
+        for (const int *a; (a = plainchanges(n)); ++count)
+            sum += checksum(a, n);
+    ms = stoptimer_ms();
+    report(alg, "static", count, sum, ms);
 
+    PermutCtx *ctx = permut_new(kind, n, 0);
+    if (!ctx)
+        return;
+    count = sum = 0;
     starttimer();
-    switch (alg) {
-        case 'c': for (; count != fac; ++count); break;
-        case 'l': for (int *a; (a = permutations(n)); ++count); break;
-        case 'p': for (int *a; (a = plainchanges(n)); ++count); break;
+    for (const int *a; (a = permut_next(ctx)); ++count)
+        sum += checksum(a, n);
+    ms = stoptimer_ms();
+    report(alg, "next", count, sum, ms);
+    permut_free(ctx);
+
+    // Bulk in one thread, then split over all threads
+    const uint64_t total = (uint64_t)count;
+    for (int pass = 0; pass < 2; ++pass) {
+        const int tc = pass ? nthreads : 1;
+        Range range[MAXTHREADS] = {0};
+        for (int i = 0; i < tc; ++i)
+            range[i] = (Range){.kind = kind, .n = n,
+                .start = total / tc * i, .count = i < tc - 1 ? total / tc : total - total / tc * i};
+        starttimer();
+        if (tc == 1)
+            rangeworker(&range[0]);
+        else {
+            int started[MAXTHREADS] = {0};
+            for (int i = 0; i < tc; ++i)
+                started[i] = !pthread_create(&range[i].tid, NULL, rangeworker, &range[i]);
+            for (int i = 0; i < tc; ++i)
+                if (started[i])
+                    pthread_join(range[i].tid, NULL);
+                else
+                    rangeworker(&range[i]);  // run it here instead
+        }
+        ms = stoptimer_ms();
+        count = sum = 0;
+        for (int i = 0; i < tc; ++i) {
+            count += range[i].done;
+            sum += range[i].sum;
+        }
+        report(alg, pass ? "threads" : "bulk", count, sum, ms);
     }
-    const double t = stoptimer_ms();
-    printf("Count: %"PRIu64" (%d! = %"PRIu64")\n", count, n, fac);
-    printf("Time: %.0f ms\n", t);
+}
+
+int main(int argc, char *argv[])
+{
+    const int n = argc > 1 ? atoi(argv[1]) : 11;
+    if (n < 1 || n > 20) {
+        fprintf(stderr, "Usage: %s [n [threads]]\n  n = 1..20\n", argv[0]);
+        return 1;
+    }
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = argc > 2 ? atoi(argv[2]) : (int)(ncpu > 0 ? ncpu : 1);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAXTHREADS)
+        nthreads = MAXTHREADS;
+
+    uint64_t fac = 1;
+    for (int i = 2; i <= n; ++i)
+        fac *= (uint64_t)i;
+    printf("%d! = %"PRIu64" permutations, %d thread%s\n", n, fac, nthreads, nthreads == 1 ? "" : "s");
+    printf("alg    mode             count             checksum        ms  Mperm/s\n");
+    bench(PERMUT_LEXIC, n, nthreads);
+    bench(PERMUT_PLAIN, n, nthreads);
     plainchanges(0);  // free mem
+    return 0;
 }
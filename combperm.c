@@ -8,6 +8,7 @@
 
 #include <stdlib.h>  // malloc, realloc, free
 #include <string.h>  // memcpy
+#include <stdint.h>  // uint64_t, UINT64_MAX
 #include "combperm.h"
 
 // Successive calls give combinations of k indices from a set of n.
@@ -80,11 +81,6 @@ static inline void swap(int *const restrict a, int *const restrict b)
     *b = tmp;
 }
 
-struct permutctx {
-    int *mem, *dir, *pos, *next;
-    int len, cap, last, move;
-};
-
 // Successive calls give permutations in lexicographic order of 'count' index numbers.
 // Ref.: https://en.wikipedia.org/wiki/Permutation#Generation_in_lexicographic_order
 // Returns pointer to first element of next permutation of 'count' index numbers.
@@ -257,3 +253,321 @@ combperm_plainchanges_reset:
     len = last = move = 0;
     return NULL;
 }
+
+// Reentrant iterators, state in PermutCtx instead of static variables.
+// Plain changes with Knuth 4A, §7.2.1.2, algorithm P: same order as plainchanges()
+// but the state is a mixed-radix counter, so it can be set from a rank directly.
+struct permutctx {
+    PermutKind kind;
+    int n, len;          // set size, result size (n, or k for combinations)
+    int *mem;            // memory arena for all arrays
+    int *a;              // current result; for combinations followed by 2 sentinels
+    int *c, *o;          // plain changes: counters and directions, index 1..n
+    int j;               // combinations: a[0..j] = 0..j are in starting position
+    int fresh;           // current result not yet returned
+    int done;            // all results visited
+    uint64_t rank, total;
+};
+
+// Number of permutations n!, or UINT64_MAX if too large
+static uint64_t factorial(const int n)
+{
+    uint64_t f = 1;
+    for (int i = 2; i <= n; ++i) {
+        if (f > UINT64_MAX / (uint64_t)i)
+            return UINT64_MAX;
+        f *= (uint64_t)i;
+    }
+    return f;
+}
+
+// Binomial coefficient C(n,k), or UINT64_MAX if too large
+static uint64_t binomial(const int n, int k)
+{
+    if (k < 0 || k > n)
+        return 0;
+    if (k > n - k)
+        k = n - k;
+    uint64_t b = 1;
+    for (int i = 1; i <= k; ++i) {
+        // b = C(n-k+i, i) is exact after every division, and only grows
+        const unsigned __int128 t = (unsigned __int128)b * (uint64_t)(n - k + i) / (uint64_t)i;
+        if (t > UINT64_MAX)
+            return UINT64_MAX;
+        b = (uint64_t)t;
+    }
+    return b;
+}
+
+// Set iterator to its first result
+static void first(PermutCtx *const ctx)
+{
+    for (int i = 0; i < ctx->len; ++i)
+        ctx->a[i] = i;
+    switch (ctx->kind) {
+        case PERMUT_LEXIC:
+            break;
+        case PERMUT_PLAIN:
+            for (int i = 1; i <= ctx->n; ++i) {
+                ctx->c[i] = 0;
+                ctx->o[i] = 1;
+            }
+            break;
+        case PERMUT_COMBIN:
+            ctx->a[ctx->len    ] = ctx->n;
+            ctx->a[ctx->len + 1] = 0;
+            ctx->j = ctx->len - 1;
+            break;
+    }
+    ctx->rank = 0;
+    ctx->fresh = 1;
+    ctx->done = 0;
+}
+
+PermutCtx *permut_new(const PermutKind kind, const int n, const int k)
+{
+    int len, size;
+    switch (kind) {
+        case PERMUT_LEXIC: len = n; size = n; break;
+        case PERMUT_PLAIN: len = n; size = n + 2 * (n + 1); break;
+        case PERMUT_COMBIN:
+            if (k <= 0 || k >= n)
+                return NULL;
+            len = k; size = k + 2;
+            break;
+        default: return NULL;
+    }
+    if (n < 1)
+        return NULL;
+    PermutCtx *ctx = malloc(sizeof *ctx);
+    if (!ctx)
+        return NULL;
+    ctx->mem = malloc((size_t)size * sizeof *ctx->mem);
+    if (!ctx->mem) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->kind = kind;
+    ctx->n = n;
+    ctx->len = len;
+    ctx->a = ctx->mem;
+    ctx->c = ctx->mem + n;
+    ctx->o = ctx->mem + n + (n + 1);
+    ctx->total = kind == PERMUT_COMBIN ? binomial(n, k) : factorial(n);
+    first(ctx);
+    return ctx;
+}
+
+void permut_free(PermutCtx *const ctx)
+{
+    if (!ctx)
+        return;
+    free(ctx->mem);
+    free(ctx);
+}
+
+// Same as permutations()
+static inline int lexicstep(PermutCtx *const ctx)
+{
+    int *const a = ctx->a;
+    int px = ctx->len - 2;
+    while (px >= 0 && a[px] >= a[px + 1])
+        --px;
+    if (px < 0)
+        return 0;
+    int py = ctx->len - 1;
+    while (a[px] >= a[py])
+        --py;
+    swap(&a[px], &a[py]);
+    for (int l = px + 1, r = ctx->len - 1; l < r; ++l, --r)
+        swap(&a[l], &a[r]);
+    return 1;
+}
+
+// Algorithm P: value j-1 sweeps between the ends while c[j] counts 0..j-1 and back.
+// s = number of larger values parked at the left end.
+static inline int plainstep(PermutCtx *const ctx)
+{
+    int *const a = ctx->a, *const c = ctx->c, *const o = ctx->o;
+    for (int j = ctx->n, s = 0; ; --j) {
+        const int q = c[j] + o[j];
+        if (q >= 0 && q != j) {
+            swap(&a[j - 1 - c[j] + s], &a[j - 1 - q + s]);
+            c[j] = q;
+            return 1;
+        }
+        if (q == j) {
+            if (j == 1)
+                return 0;
+            ++s;
+        }
+        o[j] = -o[j];
+    }
+}
+
+// Same as combinations()
+static inline int combinstep(PermutCtx *const ctx)
+{
+    int *const a = ctx->a;
+    if (ctx->j >= 0) {
+        a[ctx->j] = ctx->j + 1;
+        ctx->j--;
+        return 1;
+    }
+    if (a[0] + 1 < a[1]) {
+        a[0]++;
+        return 1;
+    }
+    int j = 0, x;
+    do {
+        j++;
+        a[j - 1] = j - 1;
+    } while ((x = a[j] + 1) == a[j + 1]);
+    if (j < ctx->len) {
+        a[j] = x;
+        ctx->j = j - 1;
+        return 1;
+    }
+    return 0;
+}
+
+static inline const int *advance(PermutCtx *const ctx)
+{
+    if (ctx->fresh) {
+        ctx->fresh = 0;
+        return ctx->a;
+    }
+    if (ctx->done)
+        return NULL;
+    int ok = 0;
+    switch (ctx->kind) {
+        case PERMUT_LEXIC : ok = lexicstep(ctx); break;
+        case PERMUT_PLAIN : ok = plainstep(ctx); break;
+        case PERMUT_COMBIN: ok = combinstep(ctx); break;
+    }
+    if (!ok) {
+        ctx->done = 1;
+        return NULL;
+    }
+    ctx->rank++;
+    return ctx->a;
+}
+
+const int *permut_next(PermutCtx *const ctx)
+{
+    return advance(ctx);
+}
+
+// Short copy, inlined instead of a call to memcpy
+static inline void copy(int *restrict dst, const int *restrict src, const int len)
+{
+    for (int i = 0; i < len; ++i)
+        dst[i] = src[i];
+}
+
+// One loop per kind, so the step function is inlined without a switch per result
+#define BULKLOOP(STEP) \
+    for (; i < count; ++i, buf += ctx->len) { \
+        if (!STEP(ctx)) { \
+            ctx->done = 1; \
+            break; \
+        } \
+        ctx->rank++; \
+        copy(buf, ctx->a, ctx->len); \
+    }
+
+int permut_bulk(PermutCtx *const ctx, int *buf, const int count)
+{
+    const size_t size = (size_t)ctx->len * sizeof *buf;
+    int i = 0;
+    if (count <= 0)
+        return 0;
+    if (ctx->fresh || ctx->done) {
+        const int *a = advance(ctx);
+        if (!a)
+            return 0;
+        memcpy(buf, a, size);
+        buf += ctx->len;
+        i = 1;
+    }
+    switch (ctx->kind) {
+        case PERMUT_LEXIC : BULKLOOP(lexicstep); break;
+        case PERMUT_PLAIN : BULKLOOP(plainstep); break;
+        case PERMUT_COMBIN: BULKLOOP(combinstep); break;
+    }
+    return i;
+}
+
+int permut_len(const PermutCtx *const ctx)
+{
+    return ctx->len;
+}
+
+uint64_t permut_total(const PermutCtx *const ctx)
+{
+    return ctx->total;
+}
+
+uint64_t permut_rank(const PermutCtx *const ctx)
+{
+    return ctx->rank;
+}
+
+int permut_seek(PermutCtx *const ctx, const uint64_t rank)
+{
+    if (ctx->total == UINT64_MAX || rank >= ctx->total)
+        return 0;
+    const int n = ctx->n;
+    int *const a = ctx->a;
+    uint64_t r = rank;
+    switch (ctx->kind) {
+        case PERMUT_LEXIC: {
+            // Factorial number system: digit i picks from the unused values in a[i..n-1]
+            uint64_t f = ctx->total;
+            for (int i = 0; i < n; ++i)
+                a[i] = i;
+            for (int i = 0; i < n; ++i) {
+                f /= (uint64_t)(n - i);
+                const int d = (int)(r / f), v = a[i + d];
+                r %= f;
+                memmove(&a[i + 1], &a[i], (size_t)d * sizeof *a);
+                a[i] = v;
+            }
+            break;
+        }
+        case PERMUT_PLAIN: {
+            // Mixed radix digits, value n-1 is fastest; odd sweeps go the other way
+            for (int m = n; m >= 1; --m) {
+                const int d = (int)(r % (uint64_t)m);
+                r /= (uint64_t)m;
+                ctx->c[m] = r & 1 ? m - 1 - d : d;
+                ctx->o[m] = r & 1 ? -1 : 1;
+            }
+            // Insert values in increasing order, value m-1 is c[m] steps from the right
+            for (int m = 1; m <= n; ++m) {
+                const int p = m - 1 - ctx->c[m];
+                memmove(&a[p + 1], &a[p], (size_t)(m - 1 - p) * sizeof *a);
+                a[p] = m - 1;
+            }
+            break;
+        }
+        case PERMUT_COMBIN: {
+            // Combinatorial number system: rank = sum of C(a[i], i+1)
+            for (int i = ctx->len - 1, x = n; i >= 0; --i) {
+                do
+                    --x;
+                while (binomial(x, i + 1) > r);
+                a[i] = x;
+                r -= binomial(x, i + 1);
+            }
+            ctx->j = -1;
+            while (ctx->j + 1 < ctx->len && a[ctx->j + 1] == ctx->j + 1)
+                ctx->j++;
+            break;
+        }
+    }
+    ctx->rank = rank;
+    ctx->fresh = 1;
+    ctx->done = 0;
+    return 1;
+}
@@ -9,8 +9,58 @@
 #ifndef COMBPERM_H
 #define COMBPERM_H
 
+#include <stdint.h>  // uint64_t
+
 typedef struct permutctx PermutCtx;
 
+typedef enum permutkind {
+    PERMUT_LEXIC,   // permutations in lexicographic order
+    PERMUT_PLAIN,   // permutations in "plain changes" order (one swap of neighbours per step)
+    PERMUT_COMBIN,  // combinations of k from n in colexicographic order (= Knuth algorithm T)
+} PermutKind;
+
+// Reentrant iterators: every context has its own state, so any number of
+// enumerations can run at the same time, also in different threads.
+// Results are arrays of index numbers: n for permutations, k for combinations.
+//
+//   PermutCtx *ctx = permut_new(PERMUT_LEXIC, 5, 0);
+//   for (const int *a; (a = permut_next(ctx)); )
+//       use(a);
+//   permut_free(ctx);
+//
+// Ranks count results from 0 in the order of the iterator. Split a range
+// across threads with one context per thread and permut_seek() to its start.
+
+// New iterator of n elements (1..n for permutations, 1..n-1 for k of combinations)
+// Returns NULL for invalid parameters or when out of memory.
+extern PermutCtx *permut_new(const PermutKind kind, const int n, const int k);
+
+// Free iterator
+extern void permut_free(PermutCtx *const ctx);
+
+// Next result, the first call gives the first one. NULL when all have been visited.
+// Returned array is owned by the iterator and changes with the next call.
+extern const int *permut_next(PermutCtx *const ctx);
+
+// Copy up to 'count' next results to buf (room for count * permut_len() ints)
+// Returns number of results copied, less than count only at the end.
+extern int permut_bulk(PermutCtx *const ctx, int *buf, const int count);
+
+// Number of ints per result (n or k)
+extern int permut_len(const PermutCtx *const ctx);
+
+// Total number of results n! or C(n,k), or UINT64_MAX if it does not fit in 64 bits
+extern uint64_t permut_total(const PermutCtx *const ctx);
+
+// Rank of the result last returned by permut_next() (or of the last one copied by permut_bulk)
+extern uint64_t permut_rank(const PermutCtx *const ctx);
+
+// Unrank: set iterator so that the next call of permut_next() gives result 'rank'
+// Returns 0 if rank is not below permut_total() (also when that does not fit in 64 bits).
+extern int permut_seek(PermutCtx *const ctx, const uint64_t rank);
+
+// Old interface below: single enumeration per process.
+
 // Successive calls give combinations of k indices from a set of n.
 // Adapted from Knuth 4A, §7.2.1.3, algorithm T.
 // Returns pointer to array of int, index 0..k-1.
@@ -37,6 +87,7 @@ extern int *permutations(const int count);
 //   Set count<=0 to free memory.
 //   NB: not thread-safe because permutation and state
 //       are stored in local static variables.
+// Same order as the PERMUT_PLAIN iterator.
 extern int *plainchanges(const int count);
 
 #endif // COMBPERM_H
@@ -1,14 +1,97 @@
-#include <stdio.h>   // stdin, stderr, fgetc, fputc, EOF
-#include <unistd.h>  // isatty, fileno
-#include <string.h>  // strtok
+// Split text into words: print every word on its own line to stdout,
+// and the number of lines, words and sentences to stderr.
+// A word is a run of anything but white space (' ', '\t', '\n', '\v', '\f', '\r').
+// A sentence ends at a word that ends with '.', '!' or '?', or at the last word.
+//
+// Input is read in large blocks and words are found in place: 64 bytes at a
+// time become a bitmask of white space (SSE2 if available), and the word
+// boundaries are the bits where it changes. A word that runs on into the
+// next block is simply continued there. Words go to one big output buffer
+// that is written when full, not one printf per word.
+//
+// Compile: gcc -std=gnu17 -Wall -O3 counttext.c
+// Usage  : counttext [file]    or    counttext < file
 
-static const char *space = " \t\f\v";  // not '\r' or '\n'
+#include <stdio.h>     // stdin, stderr, fprintf, fopen, fclose, fgets
+#include <stdlib.h>    // malloc, free
+#include <stdint.h>    // uint64_t
+#include <inttypes.h>  // PRIu64
+#include <stdbool.h>   // bool
+#include <unistd.h>    // isatty, fileno, read, write
+#include <string.h>    // memcpy, memset, strcspn
+#if defined(__SSE2__)
+    #include <emmintrin.h>  // _mm_cmpeq_epi8 etc.
+#endif
+
+#define INBLOCK  (1 << 20)  // read buffer size
+#define OUTBLOCK (1 << 20)  // write buffer size
+
+typedef struct {
+    char *buf;
+    size_t len;
+    bool err;
+} Out;
+
+// White space: bits 0..63 for bytes p[0..63]
+static inline uint64_t spacemask(const unsigned char *p, uint64_t *const newline)
+{
+    uint64_t space = 0, nl = 0;
+#if defined(__SSE2__)
+    // ' ' or '\t'..'\r' (9..13): unsigned x - 9 <= 4 via min(x - 9, 4) == x - 9
+    for (int i = 0; i < 64; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        const __m128i t = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+        const __m128i s = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(4)), t));
+        space |= (uint64_t)(uint32_t)_mm_movemask_epi8(s) << i;
+        nl |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) << i;
+    }
+#else
+    for (int i = 0; i < 64; ++i) {
+        space |= (uint64_t)(p[i] == ' ' || (unsigned char)(p[i] - '\t') <= 4) << i;
+        nl |= (uint64_t)(p[i] == '\n') << i;
+    }
+#endif
+    *newline = nl;
+    return space;
+}
+
+static inline bool isstop(const int c)
+{
+    return c == '.' || c == '!' || c == '?';
+}
+
+static void flush(Out *const out)
+{
+    for (size_t done = 0; done < out->len && !out->err; ) {
+        const ssize_t n = write(STDOUT_FILENO, out->buf + done, out->len - done);
+        if (n <= 0)
+            out->err = true;
+        else
+            done += (size_t)n;
+    }
+    out->len = 0;
+}
+
+static void emit(Out *const out, const char *s, const size_t len)
+{
+    if (out->len + len > OUTBLOCK) {
+        flush(out);
+        if (len > OUTBLOCK) {
+            // Longer than the whole buffer: write directly
+            Out big = {(char *)s, len, false};
+            flush(&big);
+            out->err |= big.err;
+            return;
+        }
+    }
+    memcpy(out->buf + out->len, s, len);
+    out->len += len;
+}
 
 int main(int argc, char *argv[])
 {
     char buf[BUFSIZ];
     FILE *f = NULL;
-    int lines = 0, words = 0, sentences = 0;
 
     if (!isatty(fileno(stdin))) {
         // Input is pipe or redirect to stdin of this program.
@@ -23,7 +106,9 @@ int main(int argc, char *argv[])
     } else {
         // Manual input.
         printf("File name? ");
+        fflush(stdout);
         if (fgets(buf, sizeof buf, stdin)) {
+            buf[strcspn(buf, "\r\n")] = '\0';
             f = fopen(buf, "r");
             if (!f) {
                 fprintf(stderr, "File not found: %s\n", buf);
@@ -31,18 +116,76 @@ int main(int argc, char *argv[])
             }
         }
     }
-    while (fgets(buf, sizeof buf, stdin)) {
-        char *s = strtok(buf, space);
-        while (s) {
-            if (*s == '\n' || *s == '\r') {
-                ++lines;
-            } else {
-                ++words;
-                printf("%s\n", s);
+    if (!f)
+        return 2;
+
+    char *in = malloc(INBLOCK);
+    Out out = {malloc(OUTBLOCK), 0, false};
+    if (!in || !out.buf) {
+        fprintf(stderr, "Out of memory.\n");
+        return 3;
+    }
+
+    const int fd = fileno(f);
+    uint64_t lines = 0, words = 0, sentences = 0;
+    bool inword = false;  // inside a word at the end of the last block
+    bool open = false;    // words since the last sentence ended
+    int last = -1;        // last byte of input, or -1 if none yet
+    ssize_t n;
+    while ((n = read(fd, in, INBLOCK)) > 0) {
+        const unsigned char *const u = (const unsigned char *)in;
+        size_t word = 0;  // start of current word in this block
+        uint64_t prevspace = !inword;
+        for (size_t base = 0; base < (size_t)n; base += 64) {
+            const size_t left = (size_t)n - base;
+            uint64_t space, newline, valid = ~UINT64_C(0);
+            if (left >= 64)
+                space = spacemask(u + base, &newline);
+            else {
+                unsigned char tail[64];
+                memcpy(tail, u + base, left);
+                memset(tail + left, 0, 64 - left);
+                space = spacemask(tail, &newline);
+                valid = (UINT64_C(1) << left) - 1;
+            }
+            lines += (uint64_t)__builtin_popcountll(newline & valid);
+            // Word starts and ends: where white space changes
+            for (uint64_t edge = (space ^ (space << 1 | prevspace)) & valid; edge; edge &= edge - 1) {
+                const size_t i = base + (size_t)__builtin_ctzll(edge);
+                if (!inword) {
+                    ++words;
+                    word = i;
+                    inword = true;
+                    open = true;
+                } else {
+                    emit(&out, in + word, i - word);
+                    emit(&out, "\n", 1);
+                    if (isstop(i > word ? u[i - 1] : last)) {
+                        ++sentences;
+                        open = false;
+                    }
+                    inword = false;
+                }
             }
-            s = strtok(NULL, space);
+            prevspace = space >> 63;
         }
+        if (inword)
+            emit(&out, in + word, (size_t)n - word);  // continued in next block
+        last = u[n - 1];
     }
-    fclose(f);
-    return 0;
+    if (n < 0)
+        perror("read");
+    if (inword)
+        emit(&out, "\n", 1);
+    if (open)
+        ++sentences;  // last word ends the last sentence
+    if (last >= 0 && last != '\n')
+        ++lines;  // no closing newline
+    flush(&out);
+    if (f != stdin)
+        fclose(f);
+    free(in);
+    free(out.buf);
+    fprintf(stderr, "lines: %"PRIu64", words: %"PRIu64", sentences: %"PRIu64"\n", lines, words, sentences);
+    return n < 0 || out.err ? 4 : 0;
 }
@@ -0,0 +1,88 @@
+// Testing CRC-32 engines
+// Compile: gcc -std=gnu17 -Wall -O3 crc32-test.c crc32.c startstoptimer.c -pthread
+// Usage  : ./a.out [MB]   (benchmark buffer size in megabytes, default 64)
+
+#include <stdio.h>     // printf
+#include <stdlib.h>    // malloc, free, atoi
+#include <stdint.h>    // uint32_t
+#include <inttypes.h>  // PRIx32
+#include "crc32.h"
+#include "startstoptimer.h"
+
+#define TESTLEN 4096
+
+typedef uint32_t (*crc32_func_t)(uint32_t, const void *, size_t);
+
+static const struct {
+    const char *name;
+    crc32_func_t func;
+} engine[] = {
+    {"bytewise", crc32_update_bytewise},
+    {"slice8"  , crc32_update_slice8  },
+    {"slice16" , crc32_update_slice16 },
+    {"clmul"   , crc32_update_clmul   },
+};
+#define ENGINES (sizeof engine / sizeof *engine)
+
+int main(int argc, char *argv[])
+{
+    unsigned char i, j, msg[10];
+
+    // Fill msg with values 0, 1, 2, 4, 8, 16, 32, 64, 128, 255
+    msg[0] = 0;
+    j = 1;
+    for (i = 1; i < 9; ++i) {
+        msg[i] = j;
+        j <<= 1;
+    }
+    msg[9] = 255;
+
+    // Test CRC-32
+    // 00000000 77073096 ee0e612c 076dc419 0edb8832 1db71064 3b6e20c8 76dc4190 edb88320 2d02ef8d (init 0)
+    // d202ef8d a505df1b 3c0c8ea1 d56f2b94 dcd967bf cfb5ffe9 e96ccf45 a4deae1d 3fba6cad ff000000 (init -1)
+    for (i = 0; i < 10; ++i) {
+        printf("%08"PRIx32" ", crc32(&msg[i], 1));
+    }
+    printf("\n");
+
+    // All engines must agree with bytewise for every length and alignment,
+    // also when streamed in two parts
+    static unsigned char test[TESTLEN + 16];
+    uint32_t r = 12345;
+    for (size_t k = 0; k < sizeof test; ++k) {
+        r = r * 1103515245 + 12345;
+        test[k] = (unsigned char)(r >> 16);
+    }
+    int fail = 0;
+    for (size_t off = 0; off < 16; ++off)
+        for (size_t len = 0; len <= TESTLEN; len += 1 + (len >> 6)) {
+            const uint32_t ref = crc32_update_bytewise(CRC32_INITVAL, test + off, len);
+            for (size_t e = 1; e < ENGINES; ++e) {
+                const size_t half = len / 3;
+                uint32_t c = engine[e].func(CRC32_INITVAL, test + off, half);
+                c = engine[e].func(c, test + off + half, len - half);
+                if (c != ref) {
+                    fprintf(stderr, "Mismatch: %s off=%zu len=%zu\n", engine[e].name, off, len);
+                    fail = 1;
+                }
+            }
+        }
+    printf("Engines agree: %s (default engine: %s)\n", fail ? "NO" : "yes", crc32_engine());
+
+    // Benchmark
+    const int mb = argc > 1 ? atoi(argv[1]) : 64;
+    const size_t size = (size_t)(mb > 0 ? mb : 64) << 20;
+    unsigned char *big = malloc(size);
+    if (!big)
+        return 1;
+    for (size_t k = 0; k < size; ++k)
+        big[k] = (unsigned char)(k * 31 + (k >> 9));
+    for (size_t e = 0; e < ENGINES; ++e) {
+        starttimer();
+        const uint32_t c = crc32_final(engine[e].func(crc32_init(), big, size));
+        const double t = stoptimer_s();
+        printf("%-8s %08"PRIx32" %8.1f MB/s\n", engine[e].name, c, size / t / (1 << 20));
+    }
+    free(big);
+    return fail;
+}
@@ -0,0 +1,38 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+// CRC-32 as used by PNG, zlib, gzip, Ethernet (reflected, polynomial 0xedb88320)
+// Code originally from https://www.w3.org/TR/PNG/#D-CRCAppendix
+// Compile with extra source file: crc32.c (and -pthread on Linux)
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint32_t
+
+#define CRC32_ONESCOMPL32  (0xffffffffU)
+#define CRC32_INITVAL      (CRC32_ONESCOMPL32)
+#define CRC32_G_POLYNOMIAL (0xedb88320U)
+
+// Streaming use:
+//   uint32_t crc = crc32_init();
+//   while (more data)
+//       crc = crc32_update(crc, buf, len);
+//   printf("%08"PRIx32"\n", crc32_final(crc));
+// Intermediate crc values are only meaningful to crc32_update() and crc32_final().
+uint32_t     crc32_init   (void);
+uint32_t     crc32_update (uint32_t crc, const void *buf, size_t len);
+uint32_t     crc32_final  (uint32_t crc);
+
+// CRC-32 of a single buffer, same as crc32_final(crc32_update(crc32_init(), buf, len))
+uint32_t     crc32        (const void *buf, size_t len);
+
+// Name of the engine picked at runtime by crc32_update(): "clmul", "slice16", "slice8" or "bytewise"
+const char * crc32_engine (void);
+
+// Individual engines, mainly for testing and benchmarking. All give the same result.
+// crc32_update_clmul() falls back to slicing-by-16 if the CPU lacks PCLMULQDQ.
+uint32_t     crc32_update_bytewise(uint32_t crc, const void *buf, size_t len);
+uint32_t     crc32_update_slice8  (uint32_t crc, const void *buf, size_t len);
+uint32_t     crc32_update_slice16 (uint32_t crc, const void *buf, size_t len);
+uint32_t     crc32_update_clmul   (uint32_t crc, const void *buf, size_t len);
+
+#endif  // CRC32_H
@@ -0,0 +1,154 @@
+#include <stdlib.h>  // malloc, calloc, free
+#include "dlx.h"
+
+// Node 0 is the root, nodes 1..ncols are column headers, then the 1s of all rows.
+// Every node is in a circular doubly linked list left/right (header row or matrix row)
+// and up/down (column). Removed nodes keep their own links, so they can be put back.
+struct dlx {
+    int ncols, nnodes, maxnodes;
+    int *left, *right, *up, *down;
+    int *col;     // column header of node
+    int *rowid;   // row id of node
+    int *size;    // number of 1s in column, for header nodes
+    int *choice;  // rows of current partial solution
+    int *sol, *len;
+    size_t count, limit;
+};
+
+Dlx *dlx_new(int ncols, int maxnodes)
+{
+    Dlx *m = calloc(1, sizeof *m);
+    if (!m)
+        return NULL;
+    const size_t n = (size_t)ncols + 1 + (size_t)maxnodes;
+    m->ncols = ncols;
+    m->nnodes = ncols + 1;
+    m->maxnodes = ncols + 1 + maxnodes;
+    m->left   = malloc(n * sizeof *m->left);
+    m->right  = malloc(n * sizeof *m->right);
+    m->up     = malloc(n * sizeof *m->up);
+    m->down   = malloc(n * sizeof *m->down);
+    m->col    = malloc(n * sizeof *m->col);
+    m->rowid  = malloc(n * sizeof *m->rowid);
+    m->size   = calloc((size_t)ncols + 1, sizeof *m->size);
+    m->choice = malloc(((size_t)ncols + 1) * sizeof *m->choice);
+    if (!m->left || !m->right || !m->up || !m->down || !m->col || !m->rowid || !m->size || !m->choice) {
+        dlx_free(m);
+        return NULL;
+    }
+    for (int i = 0; i <= ncols; ++i) {
+        m->left[i] = i ? i - 1 : ncols;
+        m->right[i] = i < ncols ? i + 1 : 0;
+        m->up[i] = m->down[i] = m->col[i] = i;
+        m->rowid[i] = -1;
+    }
+    return m;
+}
+
+void dlx_free(Dlx *m)
+{
+    if (!m)
+        return;
+    free(m->left);
+    free(m->right);
+    free(m->up);
+    free(m->down);
+    free(m->col);
+    free(m->rowid);
+    free(m->size);
+    free(m->choice);
+    free(m);
+}
+
+int dlx_addrow(Dlx *m, const int *cols, int n, int rowid)
+{
+    if (n <= 0 || m->nnodes + n > m->maxnodes)
+        return 0;
+    const int first = m->nnodes;
+    for (int i = 0; i < n; ++i) {
+        const int x = m->nnodes++, c = cols[i] + 1;
+        // insert at the bottom of column c
+        m->col[x] = c;
+        m->rowid[x] = rowid;
+        m->up[x] = m->up[c];
+        m->down[x] = c;
+        m->down[m->up[c]] = x;
+        m->up[c] = x;
+        m->size[c]++;
+        // circular list of this row
+        m->left[x] = i ? x - 1 : first + n - 1;
+        m->right[x] = i < n - 1 ? x + 1 : first;
+    }
+    return 1;
+}
+
+// Remove column c from the header list and all rows with a 1 in c from other columns
+static void cover(Dlx *m, const int c)
+{
+    m->right[m->left[c]] = m->right[c];
+    m->left[m->right[c]] = m->left[c];
+    for (int i = m->down[c]; i != c; i = m->down[i])
+        for (int j = m->right[i]; j != i; j = m->right[j]) {
+            m->down[m->up[j]] = m->down[j];
+            m->up[m->down[j]] = m->up[j];
+            m->size[m->col[j]]--;
+        }
+}
+
+// Exact reverse of cover()
+static void uncover(Dlx *m, const int c)
+{
+    for (int i = m->up[c]; i != c; i = m->up[i])
+        for (int j = m->left[i]; j != i; j = m->left[j]) {
+            m->size[m->col[j]]++;
+            m->down[m->up[j]] = j;
+            m->up[m->down[j]] = j;
+        }
+    m->right[m->left[c]] = c;
+    m->left[m->right[c]] = c;
+}
+
+// Algorithm X, branching on the column with the fewest 1s
+// Returns 1 when the solution limit is reached
+static int search(Dlx *m, const int depth)
+{
+    if (m->right[0] == 0) {
+        if (!m->count++ && m->sol) {
+            for (int i = 0; i < depth; ++i)
+                m->sol[i] = m->rowid[m->choice[i]];
+            *m->len = depth;
+        }
+        return m->limit && m->count >= m->limit;
+    }
+    int c = m->right[0];
+    for (int j = m->right[c]; j; j = m->right[j])
+        if (m->size[j] < m->size[c])
+            c = j;
+    if (!m->size[c])
+        return 0;  // dead end
+
+    int stop = 0;
+    cover(m, c);
+    for (int r = m->down[c]; r != c && !stop; r = m->down[r]) {
+        m->choice[depth] = r;
+        for (int j = m->right[r]; j != r; j = m->right[j])
+            cover(m, m->col[j]);
+        stop = search(m, depth + 1);
+        for (int j = m->left[r]; j != r; j = m->left[j])
+            uncover(m, m->col[j]);
+    }
+    uncover(m, c);
+    return stop;
+}
+
+size_t dlx_solve(Dlx *m, size_t limit, int *sol, int *len)
+{
+    int dummy;
+    m->count = 0;
+    m->limit = limit;
+    m->sol = sol;
+    m->len = len ? len : &dummy;
+    *m->len = 0;
+    search(m, 0);
+    return m->count;
+}
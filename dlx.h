@@ -0,0 +1,33 @@
+#ifndef DLX_H
+#define DLX_H
+
+// Exact cover with Knuth's Algorithm X and dancing links
+// Given a matrix of 0s and 1s, find sets of rows with exactly one 1 in every column.
+// All nodes live in one arena of contiguous index arrays (no pointer per node,
+// no allocation per node), sized when the matrix is created.
+// Ref.: Donald E. Knuth, "Dancing Links", arXiv:cs/0011047 (2000)
+// Compile with extra source file: dlx.c
+
+#include <stddef.h>  // size_t
+
+typedef struct dlx Dlx;
+
+// New empty matrix with ncols columns and room for maxnodes 1s in total
+//   returns NULL if out of memory
+Dlx   *dlx_new   (int ncols, int maxnodes);
+
+// Free matrix
+void   dlx_free  (Dlx *m);
+
+// Add row with 1s in columns cols[0..n-1] (each 0..ncols-1, no duplicates)
+//   rowid is reported back in solutions
+//   returns 0 if the arena is full
+int    dlx_addrow(Dlx *m, const int *cols, int n, int rowid);
+
+// Count exact covers, stop after limit solutions (0 = no limit)
+//   rowids of the first solution are stored in sol (room for ncols entries),
+//   its length in *len; sol and len may be NULL.
+//   Matrix is unchanged afterwards and can be solved again.
+size_t dlx_solve (Dlx *m, size_t limit, int *sol, int *len);
+
+#endif  // DLX_H
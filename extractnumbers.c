@@ -1,8 +1,164 @@
+// Print every number (run of decimal digits) in the input on its own line.
+// Input is read in large blocks; 64 bytes at a time become a bitmask of
+// digits (SSE2 if available) and the runs are where it changes. A run at the
+// end of a block is moved to the front and continued, so it is never split.
+// Runs are converted 8 digits at a time (SWAR), output is written through a
+// big buffer with a 2-digits-at-a-time integer formatter. Numbers that do not
+// fit in 64 bits are copied as digits and counted on stderr.
+//
+// Compile: gcc -std=gnu17 -Wall -O3 extractnumbers.c
+// Usage  : extractnumbers [file]    or    extractnumbers < file
+
 #include <stdio.h>
-#include <unistd.h>    // isatty, fileno
-#include <ctype.h>     // isdigit
+#include <stdlib.h>    // malloc, free
+#include <string.h>    // memcpy, memmove, memset, strcspn
 #include <stdint.h>    // uint64_t
 #include <inttypes.h>  // PRIu64
+#include <stdbool.h>   // bool
+#include <unistd.h>    // isatty, fileno, read, write
+#if defined(__SSE2__)
+    #include <emmintrin.h>  // _mm_cmpeq_epi8 etc.
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #define LITTLE_ENDIAN_SWAR 1
+#else
+    #define LITTLE_ENDIAN_SWAR 0
+#endif
+
+#define INBLOCK  (1 << 20)  // read size
+#define OUTBLOCK (1 << 20)  // write buffer size
+#define MAXCARRY 64         // longer unfinished runs are streamed as digits
+
+typedef struct {
+    char *buf;
+    size_t len;
+    bool err;
+} Out;
+
+static void flush(Out *const out)
+{
+    for (size_t done = 0; done < out->len && !out->err; ) {
+        const ssize_t n = write(STDOUT_FILENO, out->buf + done, out->len - done);
+        if (n <= 0)
+            out->err = true;
+        else
+            done += (size_t)n;
+    }
+    out->len = 0;
+}
+
+static void emit(Out *const out, const char *s, const size_t len)
+{
+    if (out->len + len > OUTBLOCK) {
+        flush(out);
+        if (len > OUTBLOCK) {
+            // Longer than the whole buffer: write directly
+            Out big = {(char *)s, len, false};
+            flush(&big);
+            out->err |= big.err;
+            return;
+        }
+    }
+    memcpy(out->buf + out->len, s, len);
+    out->len += len;
+}
+
+// Decimal digits of x and newline, two digits per division
+static void putu64(Out *const out, uint64_t x)
+{
+    static const char pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[21], *s = tmp + sizeof tmp;
+    *--s = '\n';
+    while (x >= 100) {
+        const unsigned int i = (unsigned int)(x % 100) * 2;
+        x /= 100;
+        s -= 2;
+        memcpy(s, pairs + i, 2);
+    }
+    if (x >= 10) {
+        s -= 2;
+        memcpy(s, pairs + x * 2, 2);
+    } else
+        *--s = (char)('0' + x);
+    emit(out, s, (size_t)(tmp + sizeof tmp - s));
+}
+
+// Value of exactly 8 digits
+static inline uint64_t eightdigits(const char *s)
+{
+#if LITTLE_ENDIAN_SWAR
+    // First digit in the lowest byte: combine neighbours into 2, 4, then 8 digits
+    uint64_t v;
+    memcpy(&v, s, sizeof v);
+    v -= UINT64_C(0x3030303030303030);
+    v = (v * 10 + (v >> 8)) & UINT64_C(0x00ff00ff00ff00ff);
+    v = (v * 100 + (v >> 16)) & UINT64_C(0x0000ffff0000ffff);
+    return (v * 10000 + (v >> 32)) & UINT64_C(0xffffffff);
+#else
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v = v * 10 + (uint64_t)(s[i] - '0');
+    return v;
+#endif
+}
+
+// Value of len >= 1 digits, false if more than UINT64_MAX
+static bool parse(const char *s, const size_t len, uint64_t *const x)
+{
+    if (len > 20)
+        return false;
+    // Up to 19 digits can't overflow
+    const size_t n = len < 20 ? len : 19;
+    uint64_t v = 0;
+    size_t i = 0;
+    for (; i < n % 8; ++i)
+        v = v * 10 + (uint64_t)(s[i] - '0');
+    for (; i < n; i += 8)
+        v = v * 100000000 + eightdigits(s + i);
+    if (len == 20 && (__builtin_mul_overflow(v, 10, &v) || __builtin_add_overflow(v, (uint64_t)(s[19] - '0'), &v)))
+        return false;
+    *x = v;
+    return true;
+}
+
+// Complete run of len >= 1 digits
+static void number(Out *const out, const char *s, size_t len, uint64_t *const big)
+{
+    while (len > 1 && *s == '0') {
+        ++s;
+        --len;
+    }
+    uint64_t x;
+    if (parse(s, len, &x))
+        putu64(out, x);
+    else {
+        emit(out, s, len);
+        emit(out, "\n", 1);
+        ++*big;
+    }
+}
+
+// Digits: bits 0..63 for bytes p[0..63]
+static inline uint64_t digitmask(const unsigned char *p)
+{
+    uint64_t mask = 0;
+#if defined(__SSE2__)
+    // Unsigned x - '0' <= 9 via min(x - '0', 9) == x - '0'
+    for (int i = 0; i < 64; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        const __m128i t = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+        mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(9)), t)) << i;
+    }
+#else
+    for (int i = 0; i < 64; ++i)
+        mask |= (uint64_t)((unsigned char)(p[i] - '0') <= 9) << i;
+#endif
+    return mask;
+}
 
 int main(int argc, char *argv[])
 {
@@ -22,26 +178,97 @@ int main(int argc, char *argv[])
     } else {
         // Manual input
         printf("File name? ");
+        fflush(stdout);
         if (fgets(buf, sizeof buf, stdin)) {
+            buf[strcspn(buf, "\r\n")] = '\0';
             f = fopen(buf, "r");
             if (!f) {
-                fprintf(stderr, "File not found: %s", buf);
+                fprintf(stderr, "File not found: %s\n", buf);
                 return 2;
             }
         }
     }
-    while (fgets(buf, sizeof buf, f)) {
-        for (const char *c = buf; *c; ) {
-            while (*c && !isdigit(*c))
-                ++c;
-            if (*c) {
-                uint64_t x = 0;
-                while (*c && isdigit(*c))
-                    x = x * 10 + (*c++ - '0');
-                printf("%"PRIu64"\n", x);
+    if (!f)
+        return 2;
+
+    char *in = malloc(MAXCARRY + INBLOCK);
+    Out out = {malloc(OUTBLOCK), 0, false};
+    if (!in || !out.buf) {
+        fprintf(stderr, "Out of memory.\n");
+        return 3;
+    }
+
+    const int fd = fileno(f);
+    uint64_t big = 0;       // numbers too large for 64 bits
+    size_t carry = 0;       // digits of unfinished run at the start of the buffer
+    bool streaming = false; // unfinished run too long to carry, already partly written
+    bool inrun = false;
+    ssize_t n;
+    while ((n = read(fd, in + carry, INBLOCK)) > 0) {
+        const unsigned char *const u = (const unsigned char *)in;
+        const size_t size = carry + (size_t)n;
+        size_t run = 0;  // start of current run
+        uint64_t prevdigit = streaming;  // carried digits start a new run at 0
+        inrun = streaming;
+        for (size_t base = 0; base < size; base += 64) {
+            const size_t left = size - base;
+            uint64_t digits, valid = ~UINT64_C(0);
+            if (left >= 64)
+                digits = digitmask(u + base);
+            else {
+                unsigned char tail[64];
+                memcpy(tail, u + base, left);
+                memset(tail + left, 0, 64 - left);
+                digits = digitmask(tail);
+                valid = (UINT64_C(1) << left) - 1;
             }
+            // Run starts and ends: where digits change
+            for (uint64_t edge = (digits ^ (digits << 1 | prevdigit)) & valid; edge; edge &= edge - 1) {
+                const size_t i = base + (size_t)__builtin_ctzll(edge);
+                if (!inrun) {
+                    run = i;
+                    inrun = true;
+                } else {
+                    if (streaming) {
+                        emit(&out, in + run, i - run);
+                        emit(&out, "\n", 1);
+                        ++big;
+                        streaming = false;
+                    } else
+                        number(&out, in + run, i - run, &big);
+                    inrun = false;
+                }
+            }
+            prevdigit = digits >> 63;
+        }
+        carry = 0;
+        if (inrun) {
+            // Unfinished run: keep for the next block, without leading zeros
+            if (!streaming)
+                while (run < size - 1 && in[run] == '0')
+                    ++run;
+            carry = size - run;
+            if (streaming || carry > MAXCARRY) {
+                emit(&out, in + run, carry);
+                streaming = true;
+                carry = 0;
+            } else
+                memmove(in, in + run, carry);
         }
     }
-    fclose(f);
-    return 0;
+    if (n < 0)
+        perror("read");
+    if (streaming) {
+        emit(&out, "\n", 1);
+        ++big;
+    } else if (carry)
+        number(&out, in, carry, &big);
+    flush(&out);
+    if (f != stdin)
+        fclose(f);
+    free(in);
+    free(out.buf);
+    if (big)
+        fprintf(stderr, "%"PRIu64" number%s too large for 64 bits, copied as digits.\n", big, big == 1 ? "" : "s");
+    return n < 0 || out.err ? 4 : 0;
 }
@@ -1,7 +1,15 @@
+// Compile: gcc -std=gnu17 -Wall -O3 gameoflife.c hashlife.c -pthread
+
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hashlife.h"
 
 // ANSI escape sequences
 #define HOME  "\e[H"
@@ -11,27 +19,59 @@
 
 #define NEWLINE "\n"
 
-#define MINSIZE    3
-#define MAXSIZE   32
-#define HISTORY   50
-#define DELAY   1000
-
-static uint32_t board[HISTORY][MAXSIZE];
-static int width, height;
-
-int  getbit     (uint32_t *, int, int);
+#define MINSIZE      3
+#define MAXSIZE  65536
+#define HISTORY     50
+#define DELAY     1000
+#define HLSTEPS   1000       // default number of Hashlife steps
+#define HLNODES   (1 << 22)  // garbage collect Hashlife nodes above this
+#define TILEROWS    64       // tile height in rows
+#define TILEWORDS    8       // tile width in 64-bit words
+#define MAXTHREADS 256
+
+// Board of width x height cells on a torus, one bit per cell,
+// 'words' 64-bit words per row. Padding bits after 'width' are always 0.
+// Two buffers: board (current generation) and next.
+static uint64_t *board, *next;
+static uint64_t history[HISTORY];  // hashes of previous generations
+static int width, height, words;
+static uint64_t padmask;           // valid bits in last word of a row
+
+// Board is split into tiles of TILEROWS x TILEWORDS words. Each generation is
+// compared to the one before the previous one, which is still in the next buffer.
+// If a tile and its 8 neighbours did not change that way (still life or period 2,
+// like blinkers), the tile is skipped: the next buffer already holds its next state.
+static int ntx, nty, ntiles, cur;  // tiles per row, per column, total; cur = index of tilechg for board
+static uint8_t *tilechg[2];        // tile changed in 2 generations (for board, next)
+static long *tilepop[2];           // population per tile (for board, next)
+static int *active, nactive;       // tiles to evolve this generation
+static uint64_t tileupdates;       // number of tiles evolved
+
+// Thread pool: all threads take tiles from the active list until it is empty
+static int nthreads = 1;
+static atomic_int nexttile;
+static pthread_mutex_t poollock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolwake = PTHREAD_COND_INITIALIZER, pooldone = PTHREAD_COND_INITIALIZER;
+static int poolgen, poolbusy, poolquit;
+static pthread_t pooltid[MAXTHREADS];
+
+int  getbit     (uint64_t *, int, int);
 void setbit     (int, int);
 void flpbit     (int, int);
-int  neighbours (uint32_t *, int, int);
-int  population (void);
+long population (void);
 void clearboard (void);
-void printboard (int, int);
-void seedboard  (int);
+void printboard (int, long);
+void seedboard  (long);
+long evolverect (int, int, int, int, int *);
+int  inittiles  (void);
+void freetiles  (void);
+void step       (void);
 int  evolve     (void);
+int  hashlife   (int, int);
 int  str2int    (char *, int, int);
 
 // Get bit value from board a at position (x,y)
-int getbit(uint32_t *a, int x, int y)
+int getbit(uint64_t *a, int x, int y)
 {
 	while (x < 0)
 		x += width;
@@ -39,62 +79,41 @@ int getbit(uint32_t *a, int x, int y)
 	while (y < 0)
 		y += height;
 	y %= height;
-	return (a[y] & ((uint32_t)1 << x) ? 1 : 0);
+	return (a[y * words + (x >> 6)] >> (x & 63)) & 1;
 }
 
-// Set bit on board 0 at position (x,y)
+// Set bit on current board at position (x,y)
 void setbit(int x, int y)
 {
-	uint32_t *a = board[0];
-	a[y] |= ((uint32_t)1 << x);
+	board[y * words + (x >> 6)] |= (uint64_t)1 << (x & 63);
 }
 
-// Flip bit on board 0 at position (x,y)
+// Flip bit on current board at position (x,y)
 void flpbit(int x, int y)
 {
-	uint32_t *a = board[0];
-	a[y] ^= ((uint32_t)1 << x);
-}
-
-// Count neighbours on board a at position (x,y)
-int neighbours(uint32_t *a, int x, int y)
-{
-	int i, j, sum = 0;
-	for (j = -1; j <= 1; ++j)      // row offset
-		for (i = -1; i <= 1; ++i)  // col offset
-			if (i || j)            // don't count self
-				sum += getbit(a, x + i, y + j);
-	return sum;
+	board[y * words + (x >> 6)] ^= (uint64_t)1 << (x & 63);
 }
 
-// Count population of board 0
-int population(void)
+// Count population of current board, from the tile counters
+long population(void)
 {
-	uint32_t row, *a = board[0];
-	int i, j, sum = 0;
-
-	for (j = 0; j < height; ++j) {     // every row
-		row = a[j];                    // copy row value
-		for (i = 0; i < width; ++i) {  // every column (can't use while: width might be smaller than MAXSIZE)
-			sum += row & 1;            // check bit 0
-			row >>= 1;                 // shift row value down
-		}
-	}
+	long sum = 0;
+	for (int i = 0; i < ntiles; ++i)
+		sum += tilepop[cur][i];
 	return sum;
 }
 
-// Reset board 0
+// Reset current board
 void clearboard(void)
 {
-	uint32_t *a = board[0];
-	for (int i = 0; i < MAXSIZE; ++i)
-		a[i] = 0;
+	for (long i = 0; i < (long)height * words; ++i)
+		board[i] = 0;
 }
 
-void printboard(int generation, int population)
+void printboard(int generation, long population)
 {
 	static char ruler[MAXSIZE * 2];
-	uint32_t *a = board[0];
+	uint64_t *a = board;
 	int i, j;
 	char *pch;
 
@@ -106,7 +125,7 @@ void printboard(int generation, int population)
 		*pch = '\0';
 	}
 
-	printf(HOME "gen%5u pop%4u" NEWLINE, generation, population);
+	printf(HOME "gen%5u pop%4ld" NEWLINE, generation, population);
 	puts(ruler);
 	for (j = 0; j < height; ++j)
 		for (i = 0; i < width; ++i)
@@ -114,10 +133,11 @@ void printboard(int generation, int population)
 	puts(ruler);
 }
 
-void seedboard(int nseeds)
+void seedboard(long nseeds)
 {
-	uint32_t *a = board[0];
-	int i, j, x1, y1, b1, x2, y2, b2, area = width * height;
+	uint64_t *a = board;
+	long i, j, area = (long)width * height;
+	int x1, y1, b1, x2, y2, b2;
 
 	clearboard();
 	// Test pattern
@@ -129,18 +149,18 @@ void seedboard(int nseeds)
 	a[7] = 8+16+32;
 	*/
 	for (i = 0; i < nseeds; ++i) {
-		x1 = i % width;
-		y1 = i / width;
+		x1 = (int)(i % width);
+		y1 = (int)(i / width);
 		setbit(x1, y1);
 	}
 	for (i = 0; i < area; ++i) {
-		j = rand() % (area - 1);
+		j = ((long)rand() * ((long)RAND_MAX + 1) + rand()) % (area - 1);
 		if (j >= i)
 			++j;  // random location other than i
-		x1 = i % width;
-		y1 = i / width;
-		x2 = j % width;
-		y2 = j / width;
+		x1 = (int)(i % width);
+		y1 = (int)(i / width);
+		x2 = (int)(j % width);
+		y2 = (int)(j / width);
 		b1 = getbit(a, x1, y1);
 		b2 = getbit(a, x2, y2);
 		if (b1 != b2) {
@@ -150,39 +170,284 @@ void seedboard(int nseeds)
 	}
 }
 
-int evolve(void)
+// Next generation of rows y0..y1-1, words w0..w1-1, from board to next.
+// Bit-sliced: 64 cells per operation. The eight neighbours of each cell are
+// the row above, same row and row below, each shifted left/right by one.
+// Full adders give the neighbour count as bit planes; only "2 or 3" matters.
+// Returns population of the rectangle, sets *changed if any cell is different
+// from what was in next before (= two generations ago).
+long evolverect(int y0, int y1, int w0, int w1, int *changed)
 {
-	uint32_t *a = board[0], *b = board[1];
-	int i = HISTORY, j, cur, sum;
+	const int last = words - 1, topbit = (width - 1) & 63;
+	uint64_t diff = 0;
+	long pop = 0;
+
+	for (int y = y0; y < y1; ++y) {
+		const uint64_t *row[3] = {
+			board + (long)(y ? y - 1 : height - 1) * words,
+			board + (long)y * words,
+			board + (long)(y < height - 1 ? y + 1 : 0) * words};
+		uint64_t *dst = next + (long)y * words;
+		for (int w = w0; w < w1; ++w) {
+			uint64_t l[3], c[3], r[3];
+			for (int k = 0; k < 3; ++k) {
+				const uint64_t *a = row[k];
+				c[k] = a[w];
+				// bit x of l = cell x-1, bit x of r = cell x+1, wrapping around at width
+				l[k] = c[k] << 1 | (w ? a[w - 1] >> 63 : a[last] >> topbit & 1);
+				r[k] = c[k] >> 1 | (w < last ? a[w + 1] << 63 : (a[0] & 1) << topbit);
+			}
+			// above: l+c+r, below: l+c+r, middle: l+r
+			const uint64_t a0 = l[0] ^ c[0] ^ r[0], a1 = (l[0] & c[0]) | (r[0] & (l[0] ^ c[0]));
+			const uint64_t b0 = l[2] ^ c[2] ^ r[2], b1 = (l[2] & c[2]) | (r[2] & (l[2] ^ c[2]));
+			const uint64_t m0 = l[1] ^ r[1], m1 = l[1] & r[1];
+			// ones: a0+b0+m0, carry into twos
+			const uint64_t s0 = a0 ^ b0 ^ m0, c0 = (a0 & b0) | (m0 & (a0 ^ b0));
+			// count is 2 or 3 if exactly one of the four twos-bits is set
+			const uint64_t t1 = a1 ^ b1, t2 = m1 ^ c0;
+			const uint64_t one = (t1 ^ t2) & ~((a1 & b1) | (m1 & c0) | (t1 & t2));
+			uint64_t v = one & (s0 | c[1]);
+			if (w == last)
+				v &= padmask;
+			diff |= v ^ dst[w];
+			dst[w] = v;
+			pop += __builtin_popcountll(v);
+		}
+	}
+	*changed = diff != 0;
+	return pop;
+}
 
-	// shift history up, make room for new board at board[0]
-	while (--i)
-		for (j = 0; j < height; ++j)
-			board[i][j] = board[i - 1][j];
+// Evolve tiles from the active list until none are left
+static void worktiles(void)
+{
+	int i;
+	while ((i = atomic_fetch_add_explicit(&nexttile, 1, memory_order_relaxed)) < nactive) {
+		const int t = active[i], ty = t / ntx, tx = t % ntx;
+		const int y0 = ty * TILEROWS, y1 = y0 + TILEROWS < height ? y0 + TILEROWS : height;
+		const int w0 = tx * TILEWORDS, w1 = w0 + TILEWORDS < words ? w0 + TILEWORDS : words;
+		int changed;
+		tilepop[!cur][t] = evolverect(y0, y1, w0, w1, &changed);
+		tilechg[!cur][t] = (uint8_t)changed;
+	}
+}
 
-	// next generation at board[0] from board[1]
-	clearboard();
-	for (j = 0; j < height; ++j)
-		for (i = 0; i < width; ++i) {
-			cur = getbit(b, i, j);
-			sum = neighbours(b, i, j);
-			if (sum == 3 || (sum == 2 && cur))
-				setbit(i, j);
+static void *poolworker(void *arg)
+{
+	int gen = 0;
+	(void)arg;
+	for (;;) {
+		pthread_mutex_lock(&poollock);
+		while (poolgen == gen && !poolquit)
+			pthread_cond_wait(&poolwake, &poollock);
+		if (poolquit) {
+			pthread_mutex_unlock(&poollock);
+			return NULL;
 		}
+		gen = poolgen;
+		pthread_mutex_unlock(&poollock);
 
-	// same pattern in history?
-	i = 0;
-	while (++i < HISTORY) {
-		b = board[i];
-		j = 0;
-		while (j < height && a[j] == b[j])
-			++j;
-		if (j == height)
-			return i;
+		worktiles();
+
+		pthread_mutex_lock(&poollock);
+		if (!--poolbusy)
+			pthread_cond_signal(&pooldone);
+		pthread_mutex_unlock(&poollock);
+	}
+}
+
+// Set up tiles for current board and start threads (nthreads including this one)
+// Returns 0 if out of memory
+int inittiles(void)
+{
+	ntx = (words + TILEWORDS - 1) / TILEWORDS;
+	nty = (height + TILEROWS - 1) / TILEROWS;
+	ntiles = ntx * nty;
+	tilechg[0] = malloc((size_t)ntiles);
+	tilechg[1] = malloc((size_t)ntiles);
+	tilepop[0] = calloc((size_t)ntiles, sizeof *tilepop[0]);
+	tilepop[1] = calloc((size_t)ntiles, sizeof *tilepop[1]);
+	active = malloc((size_t)ntiles * sizeof *active);
+	if (!tilechg[0] || !tilechg[1] || !tilepop[0] || !tilepop[1] || !active)
+		return 0;
+	// No generation before the first: next starts as a copy, so the first step
+	// compares generation 1 to generation 0 and a skipped tile holds the right cells
+	memcpy(next, board, (size_t)height * words * sizeof *next);
+	for (int t = 0; t < ntiles; ++t) {
+		tilechg[0][t] = tilechg[1][t] = 1;
+		const int ty = t / ntx, tx = t % ntx;
+		for (int y = ty * TILEROWS; y < height && y < (ty + 1) * TILEROWS; ++y)
+			for (int w = tx * TILEWORDS; w < words && w < (tx + 1) * TILEWORDS; ++w)
+				tilepop[0][t] += __builtin_popcountll(board[(long)y * words + w]);
+		tilepop[1][t] = tilepop[0][t];
 	}
+	cur = 0;
+
+	int started = 1;
+	for (int i = 1; i < nthreads && i < ntiles; ++i)
+		if (!pthread_create(&pooltid[started - 1], NULL, poolworker, NULL))
+			started++;
+	nthreads = started;
+	return 1;
+}
+
+void freetiles(void)
+{
+	pthread_mutex_lock(&poollock);
+	poolquit = 1;
+	pthread_cond_broadcast(&poolwake);
+	pthread_mutex_unlock(&poollock);
+	for (int i = 0; i < nthreads - 1; ++i)
+		pthread_join(pooltid[i], NULL);
+	nthreads = 1;
+	free(tilechg[0]);
+	free(tilechg[1]);
+	free(tilepop[0]);
+	free(tilepop[1]);
+	free(active);
+}
+
+// Next generation of the whole board: evolve active tiles, swap buffers
+void step(void)
+{
+	const uint8_t *chg = tilechg[cur];
+
+	// Active = tile or one of its neighbours (wrapping around) changed last time
+	nactive = 0;
+	for (int ty = 0; ty < nty; ++ty) {
+		const int up = ty ? ty - 1 : nty - 1, dn = ty < nty - 1 ? ty + 1 : 0;
+		for (int tx = 0; tx < ntx; ++tx) {
+			const int lf = tx ? tx - 1 : ntx - 1, rt = tx < ntx - 1 ? tx + 1 : 0;
+			const int t = ty * ntx + tx;
+			if (chg[up * ntx + lf] | chg[up * ntx + tx] | chg[up * ntx + rt]
+				| chg[ty * ntx + lf] | chg[t] | chg[ty * ntx + rt]
+				| chg[dn * ntx + lf] | chg[dn * ntx + tx] | chg[dn * ntx + rt])
+				active[nactive++] = t;
+			else
+				tilechg[!cur][t] = 0;  // still the same, in both buffers
+		}
+	}
+	tileupdates += (uint64_t)nactive;
+
+	atomic_store(&nexttile, 0);
+	if (nthreads > 1) {
+		pthread_mutex_lock(&poollock);
+		poolbusy = nthreads - 1;
+		++poolgen;
+		pthread_cond_broadcast(&poolwake);
+		pthread_mutex_unlock(&poollock);
+	}
+	worktiles();
+	if (nthreads > 1) {
+		pthread_mutex_lock(&poollock);
+		while (poolbusy)
+			pthread_cond_wait(&pooldone, &poollock);
+		pthread_mutex_unlock(&poollock);
+	}
+
+	uint64_t *tmp = board;
+	board = next;
+	next = tmp;
+	cur = !cur;
+}
+
+// Simple 64-bit hash of current board (FNV-1a over words)
+static uint64_t boardhash(void)
+{
+	uint64_t h = 0xcbf29ce484222325;
+	for (long i = 0; i < (long)height * words; ++i)
+		h = (h ^ board[i]) * 0x100000001b3;
+	return h;
+}
+
+int evolve(void)
+{
+	int i = HISTORY;
+
+	// shift history up, make room for hash of current board
+	while (--i)
+		history[i] = history[i - 1];
+	history[0] = boardhash();
+
+	// next generation
+	step();
+
+	// same pattern in history? (compare hashes instead of full frames)
+	const uint64_t h = boardhash();
+	for (i = 0; i < HISTORY; ++i)
+		if (history[i] == h)
+			return i + 1;
 	return 0;  // nope
 }
 
+// Run the current board as a Hashlife pattern on an unbounded plane (no wrap-around)
+// for a number of steps of 2^k generations each, stop early when all life has ceased
+// or the pattern repeats. Repeats are found by node identity: the same pattern in the
+// same place is the same node, so comparing root pointers compares whole frames.
+int hashlife(int k, int steps)
+{
+	HLNode *root, *seen[HISTORY + 1] = {0};
+	int i, done, rep = 0;
+	uint64_t ini;
+	struct timespec t0, t1;
+
+	// Life grows at most one cell per generation: all steps must stay in the largest square
+	if ((long double)steps * (long double)((uint64_t)1 << k) + (width > height ? width : height) / 2
+		> (long double)((uint64_t)1 << (HL_MAXLEVEL - 3))) {
+		fprintf(stderr, "%i steps of 2^%i generations may outgrow the Hashlife plane (2^%i cells wide).\n",
+			steps, k, HL_MAXLEVEL);
+		return 1;
+	}
+	if (!hl_init()) {
+		fprintf(stderr, "Out of memory.\n");
+		return 2;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	root = hl_trim(hl_frombits(board, width, height, words));
+	ini = root ? hl_population(root) : 0;
+	for (done = 0; root && done < steps && hl_population(root) && !rep; ++done) {
+		// shift history up, add current root
+		for (i = HISTORY; i > 0; --i)
+			seen[i] = seen[i - 1];
+		seen[0] = root;
+		// next 2^k generations, and did we see this node before?
+		root = hl_trim(hl_step(root, k));
+		for (i = 0; i < HISTORY && root && !rep; ++i)
+			if (seen[i] == root)
+				rep = i + 1;
+		if (hl_nodes() > HLNODES) {
+			seen[HISTORY] = root;  // keep history and current root
+			hl_gc(seen, HISTORY + 1);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (!root) {
+		fprintf(stderr, "Out of memory.\n");
+		hl_free();
+		return 2;
+	}
+
+	printf("Hashlife step      : 2^%i generations\n", k);
+	printf("Initial population : %"PRIu64"\n", ini);
+	printf("Current population : %"PRIu64"\n", hl_population(root));
+	uint64_t gens;
+	if (k < 64 && !__builtin_mul_overflow((uint64_t)done, (uint64_t)1 << k, &gens))
+		printf("Generations        : %"PRIu64"\n", gens);
+	else
+		printf("Generations        : %i x 2^%i\n", done, k);
+	printf("Pattern size       : 2^%i\n", hl_level(root));
+	printf("Nodes              : %zu\n", hl_nodes());
+	printf("Time               : %.3f s\n", (double)(t1.tv_sec - t0.tv_sec) + 1e-9 * (double)(t1.tv_nsec - t0.tv_nsec));
+	if (!hl_population(root))
+		puts("All life has ceased to exist.");
+	else if (rep == 1)
+		puts(k ? "Static pattern or period divides step." : "Static pattern, evolutionary dead end.");
+	else if (rep)
+		printf("Pattern repeating every %i steps of 2^%i generations.\n", rep, k);
+	hl_free();
+	return 0;
+}
+
 int str2int(char *s, int min, int max)
 {
 	int n = atoi(s);
@@ -195,30 +460,88 @@ int str2int(char *s, int min, int max)
 
 int main(int argc, char *argv[])
 {
-	int i, ini, pop, gen = 0, rep = 0, delay = 10;
-	uint32_t avg = 0;
+	int gen = 0, rep = 0, delay = 10, bench = 0, quad = 0;
+	long ini, pop;
+	double avg = 0;
 	clock_t t;
 	srand((unsigned int)time(NULL));
 
-	if (argc < 4 || argc > 5 || !argv) {
+	if (argc > 1 && argv && argv[1] && argv[1][0] == '-') {
+		bench = argv[1][1] == 'b';  // headless benchmark: last argument is number of generations
+		quad = argv[1][1] == 'H';   // Hashlife: log2 of generations per step, number of steps
+		--argc;
+		++argv;
+	}
+	if (argc < 4 || argc > 5 + quad + bench || !argv) {
 		puts("Game of Life - Ewoud Dronkert 2019");
 		printf("Usage: %s <width %u..%u> <height %u..%u> <initial occupation 0..100> [delay 0..100]\n", argv && argv[0] ? argv[0] : "gameoflife", MINSIZE, MAXSIZE, MINSIZE, MAXSIZE);
+		printf("       %s -b <width> <height> <initial occupation 0..100> [generations [threads]]\n", argv && argv[0] ? argv[0] : "gameoflife");
+		printf("       %s -H <width> <height> <initial occupation 0..100> [log2 step 0..60 [steps]]\n", argv && argv[0] ? argv[0] : "gameoflife");
 		return 1;
 	}
 
-	// clear screen, hide cursor
-	printf(CLEAR HIDECUR);
-	fflush(stdout);
-
 	// Initialise main parameters from command line arguments
 	width = str2int(argv[1], MINSIZE, MAXSIZE);
 	height = str2int(argv[2], MINSIZE, MAXSIZE);
-	avg = ini = pop = str2int(argv[3], 0, 100) * width * height / 100;
-	if (argc == 5)
-		delay = str2int(argv[4], 0, 100);
+	words = (width + 63) >> 6;
+	padmask = width & 63 ? ((uint64_t)1 << (width & 63)) - 1 : ~(uint64_t)0;
+	board = calloc((size_t)height * words, sizeof *board);
+	next = calloc((size_t)height * words, sizeof *next);
+	if (!board || !next) {
+		fprintf(stderr, "Board too big.\n");
+		return 2;
+	}
+	ini = pop = (long)str2int(argv[3], 0, 100) * width * height / 100;
+	avg = ini;
+	if (argc >= 5 && !quad)
+		delay = str2int(argv[4], 0, bench ? 1000000 : 100);
 	delay *= DELAY;
+	nthreads = argc >= 6 && bench ? atoi(argv[5]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > MAXTHREADS)
+		nthreads = MAXTHREADS;
 
 	seedboard(ini);              // randomised initial population of size 'ini'
+
+	if (quad) {
+		rep = hashlife(argc >= 5 ? str2int(argv[4], 0, 60) : 0, argc >= 6 ? str2int(argv[5], 1, 1 << 30) : HLSTEPS);
+		free(board);
+		free(next);
+		return rep;
+	}
+
+	if (!inittiles()) {
+		fprintf(stderr, "Board too big.\n");
+		return 2;
+	}
+
+	if (bench) {
+		// Headless: fixed number of generations, no history, no display
+		const int gens = delay ? delay / DELAY : 100;
+		struct timespec t0, t1;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (gen = 0; gen < gens; ++gen)
+			step();
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		const double s = (double)(t1.tv_sec - t0.tv_sec) + 1e-9 * (double)(t1.tv_nsec - t0.tv_nsec);
+		printf("Board              : %i x %i\n", width, height);
+		printf("Threads            : %i\n", nthreads);
+		printf("Generations        : %i\n", gens);
+		printf("Current population : %ld\n", population());
+		printf("Active tiles       : %.1f%%\n", 100.0 * (double)tileupdates / ((double)ntiles * gens));
+		printf("Time               : %.3f s\n", s);
+		printf("Cell updates/s     : %.3e\n", (double)width * height * gens / s);
+		freetiles();
+		free(board);
+		free(next);
+		return 0;
+	}
+
+	// clear screen, hide cursor
+	printf(CLEAR HIDECUR);
+	fflush(stdout);
+
 	printboard(0, ini);          // show initial situation
 
 	t = clock();                 // 1 s delay to see the initial pattern
@@ -236,10 +559,10 @@ int main(int argc, char *argv[])
 	}
 
 	// Summary
-	printf("Size of the world  : %4i\n", width * height);
-	printf("Initial population : %4i\n", ini);
-	printf("Average population : %6.1f\n", (float)avg/(gen + 1));
-	printf("Current population : %4i\n", pop);
+	printf("Size of the world  : %4ld\n", (long)width * height);
+	printf("Initial population : %4ld\n", ini);
+	printf("Average population : %6.1f\n", avg / (gen + 1));
+	printf("Current population : %4ld\n", pop);
 	printf("Generations        : %4i\n", gen);
 	if (!pop)
 		puts("All life has ceased to exist.");
@@ -252,5 +575,8 @@ int main(int argc, char *argv[])
 	printf(SHOWCUR);
 	fflush(stdout);
 
+	freetiles();
+	free(board);
+	free(next);
 	return 0;
 }
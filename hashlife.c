@@ -0,0 +1,326 @@
+#include <stdlib.h>  // malloc, calloc, free
+#include <stdint.h>  // uint64_t, uintptr_t
+#include "hashlife.h"
+
+#define MAXLEVEL   HL_MAXLEVEL
+#define BLOCKNODES 65536  // nodes per allocation block
+#define MINBUCKETS 65536  // initial hash table size (power of 2)
+
+struct hlnode {
+    HLNode *nw, *ne, *sw, *se;  // children, NULL for level 0 (single cell)
+    HLNode *result;             // memoised centre after 2^min(step, level-2) generations
+    HLNode *chain;              // next node in hash bucket, or in free list
+    uint64_t pop;               // live cells
+    int level;                  // square of 2^level x 2^level cells
+    int mark;                   // reachable during garbage collection
+};
+
+typedef struct block {
+    struct block *prev;
+    HLNode node[BLOCKNODES];
+} Block;
+
+static HLNode dead = {.level = 0, .pop = 0}, alive = {.level = 0, .pop = 1};
+static HLNode **bucket;           // hash table of all nodes with level >= 1
+static size_t nbuckets, nnodes;
+static HLNode *freelist;
+static Block *blocks;
+static size_t blockused = BLOCKNODES;
+static HLNode *empty[MAXLEVEL + 1];  // cached empty squares
+static int stepk = -1;               // log2 of generations per step that results are valid for
+
+static inline size_t hash(const HLNode *nw, const HLNode *ne, const HLNode *sw, const HLNode *se)
+{
+    uint64_t h = (uintptr_t)nw;
+    h = h * 0x9e3779b97f4a7c15 + (uintptr_t)ne;
+    h = h * 0x9e3779b97f4a7c15 + (uintptr_t)sw;
+    h = h * 0x9e3779b97f4a7c15 + (uintptr_t)se;
+    return (size_t)(h ^ h >> 29);
+}
+
+static int grow(void)
+{
+    const size_t n = nbuckets ? nbuckets << 1 : MINBUCKETS;
+    HLNode **b = calloc(n, sizeof *b);
+    if (!b)
+        return 0;
+    for (size_t i = 0; i < nbuckets; ++i)
+        for (HLNode *p = bucket[i], *q; p; p = q) {
+            q = p->chain;
+            const size_t j = hash(p->nw, p->ne, p->sw, p->se) & (n - 1);
+            p->chain = b[j];
+            b[j] = p;
+        }
+    free(bucket);
+    bucket = b;
+    nbuckets = n;
+    return 1;
+}
+
+static HLNode *newnode(void)
+{
+    if (freelist) {
+        HLNode *p = freelist;
+        freelist = p->chain;
+        return p;
+    }
+    if (blockused == BLOCKNODES) {
+        Block *b = malloc(sizeof *b);
+        if (!b)
+            return NULL;
+        b->prev = blocks;
+        blocks = b;
+        blockused = 0;
+    }
+    return &blocks->node[blockused++];
+}
+
+// The unique node with these children
+static HLNode *join(HLNode *nw, HLNode *ne, HLNode *sw, HLNode *se)
+{
+    if (!nw || !ne || !sw || !se)
+        return NULL;  // out of memory further down
+    size_t i = hash(nw, ne, sw, se) & (nbuckets - 1);
+    for (HLNode *p = bucket[i]; p; p = p->chain)
+        if (p->nw == nw && p->ne == ne && p->sw == sw && p->se == se)
+            return p;
+    if (nnodes >= nbuckets) {
+        if (!grow())
+            return NULL;
+        i = hash(nw, ne, sw, se) & (nbuckets - 1);
+    }
+    HLNode *p = newnode();
+    if (!p)
+        return NULL;
+    *p = (HLNode){nw, ne, sw, se, NULL, bucket[i], nw->pop + ne->pop + sw->pop + se->pop, nw->level + 1, 0};
+    bucket[i] = p;
+    ++nnodes;
+    return p;
+}
+
+static HLNode *emptynode(int level)
+{
+    if (!level)
+        return &dead;
+    if (!empty[level]) {
+        HLNode *e = emptynode(level - 1);
+        empty[level] = join(e, e, e, e);
+    }
+    return empty[level];
+}
+
+int hl_init(void)
+{
+    return nbuckets || grow();
+}
+
+void hl_free(void)
+{
+    while (blocks) {
+        Block *b = blocks->prev;
+        free(blocks);
+        blocks = b;
+    }
+    free(bucket);
+    bucket = NULL;
+    nbuckets = nnodes = 0;
+    blockused = BLOCKNODES;
+    freelist = NULL;
+    for (int i = 0; i <= MAXLEVEL; ++i)
+        empty[i] = NULL;
+    stepk = -1;
+}
+
+// Same square, one level bigger, with an empty border around it; NULL if too big
+static HLNode *expand(HLNode *n)
+{
+    if (n->level >= MAXLEVEL)
+        return NULL;
+    HLNode *e = emptynode(n->level - 1);
+    return join(
+        join(e, e, e, n->nw), join(e, e, n->ne, e),
+        join(e, n->sw, e, e), join(n->se, e, e, e));
+}
+
+// Inner square of half the size
+static HLNode *centre(HLNode *n)
+{
+    return join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+}
+
+// One generation of the 2x2 centre of a 4x4 square
+static HLNode *slow4(HLNode *n)
+{
+    // 16 cells as bits, row by row from the top left
+    const HLNode *q[4] = {n->nw, n->ne, n->sw, n->se};
+    unsigned int b = 0;
+    for (int i = 0; i < 4; ++i) {
+        const int x = (i & 1) << 1, y = (i & 2);
+        b |= (unsigned int)q[i]->nw->pop << (y * 4 + x);
+        b |= (unsigned int)q[i]->ne->pop << (y * 4 + x + 1);
+        b |= (unsigned int)q[i]->sw->pop << (y * 4 + x + 4);
+        b |= (unsigned int)q[i]->se->pop << (y * 4 + x + 5);
+    }
+    HLNode *c[4];
+    for (int i = 0; i < 4; ++i) {
+        const int x = 1 + (i & 1), y = 1 + (i >> 1);
+        int sum = 0;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx)
+                if (dx || dy)
+                    sum += b >> ((y + dy) * 4 + x + dx) & 1;
+        const int self = b >> (y * 4 + x) & 1;
+        c[i] = sum == 3 || (sum == 2 && self) ? &alive : &dead;
+    }
+    return join(c[0], c[1], c[2], c[3]);
+}
+
+// Centre of node n after 2^min(stepk, level-2) generations
+static HLNode *successor(HLNode *n)
+{
+    if (!n)
+        return NULL;  // out of memory
+    if (n->result)
+        return n->result;
+    if (!n->pop)
+        return n->result = emptynode(n->level - 1);
+    if (n->level == 2)
+        return n->result = slow4(n);
+
+    // Nine overlapping squares of half the size
+    HLNode *s[9] = {
+        n->nw, join(n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw), n->ne,
+        join(n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne), centre(n), join(n->ne->sw, n->ne->se, n->se->nw, n->se->ne),
+        n->sw, join(n->sw->ne, n->se->nw, n->sw->se, n->se->sw), n->se};
+    // Full speed: advance twice by 2^(level-3), otherwise only the second time
+    const int full = stepk >= n->level - 2;
+    for (int i = 0; i < 9; ++i) {
+        if (!s[i])
+            return NULL;
+        s[i] = full ? successor(s[i]) : centre(s[i]);
+    }
+    HLNode *r = join(
+        successor(join(s[0], s[1], s[3], s[4])), successor(join(s[1], s[2], s[4], s[5])),
+        successor(join(s[3], s[4], s[6], s[7])), successor(join(s[4], s[5], s[7], s[8])));
+    return n->result = r;
+}
+
+// Build square of 2^level cells with top left corner at board position (x, y)
+static HLNode *build(const uint64_t *rows, int width, int height, int words, int level, long x, long y)
+{
+    const long size = 1L << level;
+    if (x >= width || y >= height || x + size <= 0 || y + size <= 0)
+        return emptynode(level);
+    if (!level)
+        return x < 0 || y < 0 || !(rows[y * words + (x >> 6)] >> (x & 63) & 1) ? &dead : &alive;
+    const long h = size >> 1;
+    return join(
+        build(rows, width, height, words, level - 1, x, y),
+        build(rows, width, height, words, level - 1, x + h, y),
+        build(rows, width, height, words, level - 1, x, y + h),
+        build(rows, width, height, words, level - 1, x + h, y + h));
+}
+
+HLNode *hl_frombits(const uint64_t *rows, int width, int height, int words)
+{
+    int level = 3;
+    while ((1L << level) < width || (1L << level) < height)
+        ++level;
+    const long size = 1L << level;
+    return build(rows, width, height, words, level, -(size - width) / 2, -(size - height) / 2);
+}
+
+// Pattern is within the centre quarter of the square (at most half the width)
+static int inner(const HLNode *n, int depth)
+{
+    const HLNode *q[4] = {n->nw, n->ne, n->sw, n->se};
+    for (int i = 0; i < 4; ++i) {
+        const HLNode *p = q[i];
+        for (int d = 0; d < depth; ++d)
+            p = i == 0 ? p->se : i == 1 ? p->sw : i == 2 ? p->ne : p->nw;
+        if (p->pop != q[i]->pop)
+            return 0;
+    }
+    return 1;
+}
+
+HLNode *hl_step(HLNode *root, int k)
+{
+    if (!root || k < 0 || k > 60 || k + 3 > MAXLEVEL)
+        return NULL;
+    if (k != stepk) {
+        // memoised results are for another step size
+        for (size_t i = 0; i < nbuckets; ++i)
+            for (HLNode *p = bucket[i]; p; p = p->chain)
+                p->result = NULL;
+        stepk = k;
+    }
+    // Room for the pattern to grow 2^k cells in every direction,
+    // and a root big enough to advance 2^k generations at once
+    while (root && (root->level < k + 3 || !inner(root, 2)))
+        root = expand(root);
+    return root ? successor(root) : NULL;
+}
+
+HLNode *hl_trim(HLNode *root)
+{
+    while (root && root->level < 3)
+        root = expand(root);
+    while (root && root->level > 3 && inner(root, 1))
+        root = centre(root);
+    return root;
+}
+
+uint64_t hl_population(const HLNode *node)
+{
+    return node->pop;
+}
+
+int hl_level(const HLNode *node)
+{
+    return node->level;
+}
+
+size_t hl_nodes(void)
+{
+    return nnodes;
+}
+
+static void mark(HLNode *n)
+{
+    if (n->mark || !n->level)
+        return;
+    n->mark = 1;
+    mark(n->nw);
+    mark(n->ne);
+    mark(n->sw);
+    mark(n->se);
+}
+
+void hl_gc(HLNode * const *roots, int n)
+{
+    for (int i = 0; i < n; ++i)
+        if (roots[i])
+            mark(roots[i]);
+    // Unreachable nodes to free list
+    for (size_t i = 0; i < nbuckets; ++i)
+        for (HLNode **pp = &bucket[i], *p; (p = *pp); )
+            if (p->mark)
+                pp = &p->chain;
+            else {
+                *pp = p->chain;
+                p->chain = freelist;
+                freelist = p;
+                --nnodes;
+            }
+    // Drop results that were freed, then clear marks
+    for (size_t i = 0; i < nbuckets; ++i)
+        for (HLNode *p = bucket[i]; p; p = p->chain)
+            if (p->result && p->result->level && !p->result->mark)
+                p->result = NULL;
+    for (size_t i = 0; i < nbuckets; ++i)
+        for (HLNode *p = bucket[i]; p; p = p->chain)
+            p->mark = 0;
+    for (int i = 0; i <= MAXLEVEL; ++i)
+        empty[i] = NULL;
+}
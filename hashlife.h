@@ -0,0 +1,52 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+// Hashlife: Conway's Game of Life on an unbounded plane as a quadtree
+// Every square of 2^k x 2^k cells is a node with four children of 2^(k-1) x 2^(k-1).
+// Nodes are hash-consed: equal squares are the same node, anywhere and at any time,
+// and the evolved centre of a node is memoised. Repeated structure is computed once,
+// so memory and time follow the structure of a pattern, not its area or age.
+// Two patterns are equal if and only if their (trimmed) root nodes are equal pointers.
+// Ref.: Bill Gosper, "Exploiting regularities in large cellular spaces", Physica D 10 (1984)
+// Compile with extra source file: hashlife.c
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint64_t
+
+typedef struct hlnode HLNode;
+
+// Largest square is 2^HL_MAXLEVEL x 2^HL_MAXLEVEL cells, centred on the origin.
+// Stepping works while every live cell stays within 2^(HL_MAXLEVEL - 3) of the origin.
+#define HL_MAXLEVEL 64
+
+// Set up node table; call once before any other hl_ function
+// Returns 0 if out of memory
+int      hl_init      (void);
+
+// Free all nodes
+void     hl_free      (void);
+
+// Quadtree of a bit board with the same layout as gameoflife.c:
+//   height rows of 'words' 64-bit words, bit x of a row = cell x (x < width).
+// The board is centred on the origin of the plane; everything else is dead.
+HLNode * hl_frombits  (const uint64_t *rows, int width, int height, int words);
+
+// Advance pattern 2^k generations (0 <= k <= 60), returns new root
+// or NULL if out of memory or the pattern would outgrow the largest square
+HLNode * hl_step      (HLNode *root, int k);
+
+// Smallest root (level >= 3) holding the same pattern; use before comparing roots
+HLNode * hl_trim      (HLNode *root);
+
+// Number of live cells, size of square (log2 of width)
+uint64_t hl_population(const HLNode *node);
+int      hl_level     (const HLNode *node);
+
+// Number of nodes in use
+size_t   hl_nodes     (void);
+
+// Garbage collection: free all nodes not reachable from roots[0..n-1]
+// Memoised results are kept where possible. Pointers to other nodes become invalid.
+void     hl_gc        (HLNode * const *roots, int n);
+
+#endif  // HASHLIFE_H
@@ -0,0 +1,79 @@
+// Testing multi-buffer MD5 against scalar mymd5()
+// Compile: gcc -std=gnu17 -Wall -O3 mymd5-test.c mymd5.c startstoptimer.c
+// Usage  : ./a.out [count]   (number of messages to hash per lane width, default 1000000)
+
+#include <stdio.h>     // printf, snprintf
+#include <stdlib.h>    // malloc, free, atoi
+#include <string.h>    // strcmp, memset
+#include "mymd5.h"
+#include "startstoptimer.h"
+
+#define MAXLEN 200  // test message lengths 0..MAXLEN-1
+#define MSGSIZE 40  // buffer size for benchmark messages (and in-place digests)
+
+int main(int argc, char *argv[])
+{
+    static const int width[] = {1, 4, 8, 16};
+    const int nwidth = sizeof width / sizeof *width;
+
+    // Correctness: batch of messages with all lengths, compared to scalar
+    static char text[MAXLEN][MAXLEN + 1], ref[MAXLEN][33], out[MAXLEN][33];
+    const char *msg[MAXLEN];
+    char *dig[MAXLEN];
+    for (int i = 0; i < MAXLEN; ++i) {
+        for (int j = 0; j < i; ++j)
+            text[i][j] = (char)('a' + (i * 7 + j) % 26);
+        msg[i] = text[i];
+        dig[i] = out[i];
+        mymd5(text[i], ref[i]);
+    }
+    int fail = 0;
+    for (int w = 0; w < nwidth; ++w) {
+        memset(out, 0, sizeof out);
+        mymd5_batch_lanes(msg, dig, MAXLEN, width[w]);
+        for (int i = 0; i < MAXLEN; ++i)
+            if (strcmp(ref[i], out[i])) {
+                fprintf(stderr, "Mismatch: lanes=%d len=%d\n", width[w], i);
+                fail = 1;
+            }
+    }
+    char st1[MSGSIZE] = "stretch", st2[MSGSIZE] = "stretch";
+    char *pst2 = st2;
+    mymd5_stretch(st1, 1000);
+    mymd5_stretch_batch(&pst2, 1, 1000, 16);
+    fail |= strcmp(st1, st2) != 0;
+    printf("Batch equals scalar: %s (max lanes on this CPU: %d)\n", fail ? "NO" : "yes", mymd5_lanes());
+
+    // Benchmark: many short independent messages like password candidates
+    const int count = argc > 1 && atoi(argv[1]) > 0 ? atoi(argv[1]) : 1000000;
+    char *mem = malloc((size_t)count * MSGSIZE);
+    char **buf = malloc((size_t)count * sizeof *buf);
+    if (!mem || !buf)
+        return 1;
+    for (int i = 0; i < count; ++i)
+        buf[i] = mem + (size_t)i * MSGSIZE;
+
+    // Current implementation: one message at a time
+    for (int i = 0; i < count; ++i)
+        snprintf(buf[i], MSGSIZE, "password%d", i);
+    starttimer();
+    for (int i = 0; i < count; ++i)
+        mymd5_inplace(buf[i]);
+    double t = stoptimer_s();
+    printf("mymd5       : %10.0f hashes/s\n", count / t);
+
+    for (int w = 0; w < nwidth; ++w) {
+        if (width[w] > mymd5_lanes())
+            break;
+        for (int i = 0; i < count; ++i)
+            snprintf(buf[i], MSGSIZE, "password%d", i);
+        starttimer_q();
+        mymd5_batch_lanes((const char * const *)buf, buf, count, width[w]);
+        t = stoptimer_s();
+        printf("lanes = %2d  : %10.0f hashes/s\n", width[w], count / t);
+    }
+
+    free(buf);
+    free(mem);
+    return fail;
+}
@@ -1,6 +1,7 @@
-#include <stdio.h>    // fputs, size_t
-#include <stdint.h>   // uint8_t, uint32_t, uint64_t
-#include <stdbool.h>  // bool, false, true
+#include <stdio.h>    // puts
+#include <string.h>   // strlen, memcpy, memset
+#include <stdint.h>   // uint8_t, uint32_t, uint64_t, UINT32_MAX
+#include <stdbool.h>  // bool
 #include "mymd5.h"
 
 // Single hex character from value [0..15], hopefully fast
@@ -9,118 +10,170 @@ static inline char hexc(const uint8_t val)
     return "0123456789abcdef"[val];
 }
 
-void mymd5(const char * const message, char * const digest)
+static const uint32_t rot[64] = {
+    7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,
+    5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,
+    4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,
+    6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21};
+static const uint32_t K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+
+
+// Process one 512-bit (64-byte) chunk, straight from the caller's buffer
+static void mymd5_block(uint32_t * const sum, const uint8_t * const chunk)
 {
-    static const uint32_t rot[64] = {
-        7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,
-        5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,
-        4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,
-        6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21};
-    static const uint32_t K[64] = {
-        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
-        0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
-        0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
-        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
-        0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
-        0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
-        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
-        0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
-        0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
-        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
-        0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
-        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+    // Break 512-bit message into sixteen 32-bit words M[j]
+    uint32_t M[16];
+    for (int j = 0; j < 16; ++j) {
+        int k = j << 2;  // j * 4
+        M[j] = (uint32_t)chunk[k + 3] << 24  // high to low prec: cast, shift, or
+             | (uint32_t)chunk[k + 2] << 16
+             | (uint32_t)chunk[k + 1] <<  8
+             | (uint32_t)chunk[k];
+    }
 
+    uint32_t A = sum[0], B = sum[1], C = sum[2], D = sum[3];
+    for (uint32_t i = 0; i < 64; ++i) {
+        uint32_t F, g;
+        switch (i >> 4) {
+            case 0:
+                F = D ^ (B & (C ^ D));
+                g = i;
+                break;
+            case 1:
+                F = C ^ (D & (B ^ C));
+                g = (i * 5 + 1) & 0xf;
+                break;
+            case 2:
+                F = B ^ C ^ D;
+                g = (i * 3 + 5) & 0xf;
+                break;
+            default:
+                F = C ^ (B | ~D);
+                g = (i * 7) & 0xf;
+                break;
+        }
+        F += A + K[i] + M[g];
+        A = D;
+        D = C;
+        C = B;
+        B += F << rot[i] | F >> (32 - rot[i]);
+    }
+    sum[0] += A;
+    sum[1] += B;
+    sum[2] += C;
+    sum[3] += D;
+}
+
+void mymd5_init(MyMd5Ctx * const ctx)
+{
     // a0, b0, c0, d0
-    uint32_t sum[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    ctx->sum[0] = 0x67452301;
+    ctx->sum[1] = 0xefcdab89;
+    ctx->sum[2] = 0x98badcfe;
+    ctx->sum[3] = 0x10325476;
+    ctx->msglen = 0;
+    ctx->buflen = 0;
+}
 
-    uint64_t msglen = 0;  // message length in bytes (later in bits mod 2^64)
-    const char *c = message;
-    bool padded = false, terminated = false;
+void mymd5_update(MyMd5Ctx * const ctx, const void * const data, size_t len)
+{
+    const uint8_t *p = data;
+    ctx->msglen += len;
 
-    // for each 512-bit (64-byte) chunk of padded message do
-    while (!terminated) {
+    // Top up a partial chunk left over from the previous call
+    if (ctx->buflen) {
+        size_t n = 64 - ctx->buflen;
+        if (n > len)
+            n = len;
+        memcpy(ctx->buf + ctx->buflen, p, n);
+        ctx->buflen += n;
+        p += n;
+        len -= n;
+        if (ctx->buflen < 64)
+            return;
+        mymd5_block(ctx->sum, ctx->buf);
+        ctx->buflen = 0;
+    }
 
-        size_t chunklen = 0;
-        uint8_t chunk[64] = {0};
+    // Whole chunks without copying
+    for (; len >= 64; p += 64, len -= 64)
+        mymd5_block(ctx->sum, p);
 
-        while (*c && chunklen < 64)
-            chunk[chunklen++] = (uint8_t)*c++;
-        msglen += chunklen;
+    // Save the rest for next time
+    if (len) {
+        memcpy(ctx->buf, p, len);
+        ctx->buflen = len;
+    }
+}
 
-        // Padding: append 0x80 and pad with 0x00 bytes so that the message length in bytes ≡ 56 (mod 64).
-        if (chunklen < 64) {
-            if (!padded) {
-                chunk[chunklen++] = 0x80;  // rest of chunk array is already zero from initialisation
-                padded = true;
-            }
-            if (chunklen <= 56) {
-                // Store length of original message *in bits *in last 64 bits of chunk (little-endian!)
-                chunklen = 56;
-                msglen <<= 3;  // byte count is now bit count (mod 2^64)
-                while (msglen) {
-                    chunk[chunklen++] = (uint8_t)msglen;  // use only the LSByte
-                    msglen >>= 8;  // next byte
-                }
-                terminated = true;
-            }
-        }
+void mymd5_final(MyMd5Ctx * const ctx, uint8_t * const digest)
+{
+    // Length of original message *in bits* (mod 2^64)
+    uint64_t msglen = ctx->msglen << 3;
 
-        // Break 512-bit message into sixteen 32-bit words M[j]
-        uint32_t M[16];
-        for (int j = 0; j < 16; ++j) {
-            int k = j << 2;  // j * 4
-            M[j] = (uint32_t)chunk[k + 3] << 24  // high to low prec: cast, shift, or
-                 | (uint32_t)chunk[k + 2] << 16
-                 | (uint32_t)chunk[k + 1] <<  8
-                 | (uint32_t)chunk[k];
-        }
+    // Padding: append 0x80 and pad with 0x00 bytes so that the message length in bytes ≡ 56 (mod 64).
+    size_t n = ctx->buflen;
+    ctx->buf[n++] = 0x80;
+    if (n > 56) {
+        memset(ctx->buf + n, 0, 64 - n);
+        mymd5_block(ctx->sum, ctx->buf);
+        n = 0;
+    }
+    memset(ctx->buf + n, 0, 56 - n);
 
-        uint32_t A = sum[0], B = sum[1], C = sum[2], D = sum[3];
-        for (uint32_t i = 0; i < 64; ++i) {
-            uint32_t F, g;
-            switch (i >> 4) {
-                case 0:
-                    F = D ^ (B & (C ^ D));
-                    g = i;
-                    break;
-                case 1:
-                    F = C ^ (D & (B ^ C));
-                    g = (i * 5 + 1) & 0xf;
-                    break;
-                case 2:
-                    F = B ^ C ^ D;
-                    g = (i * 3 + 5) & 0xf;
-                    break;
-                default:
-                    F = C ^ (B | ~D);
-                    g = (i * 7) & 0xf;
-                    break;
-            }
-            F += A + K[i] + M[g];
-            A = D;
-            D = C;
-            C = B;
-            B += F << rot[i] | F >> (32 - rot[i]);
-        }
-        sum[0] += A;
-        sum[1] += B;
-        sum[2] += C;
-        sum[3] += D;
+    // Store length in last 64 bits of chunk (little-endian!)
+    for (n = 56; n < 64; ++n) {
+        ctx->buf[n] = (uint8_t)msglen;  // use only the LSByte
+        msglen >>= 8;  // next byte
     }
+    mymd5_block(ctx->sum, ctx->buf);
 
-    // Save hex digest[0..31]
-    char *d = digest;
+    // Save binary digest[0..15], little-endian words
+    uint8_t *d = digest;
     for (int i = 0; i < 4; ++i)
-        for (int j = 0; j < 4; ++j) {
-            *d++ = hexc(sum[i] >> 4 & 0xf);  // high to low prec: shift, and
-            *d++ = hexc(sum[i]      & 0xf);
-            sum[i] >>= 8;
-        }
-    *d = '\0';  // digest[32] = NUL
+        for (int j = 0; j < 4; ++j)
+            *d++ = (uint8_t)(ctx->sum[i] >> (j << 3));
+}
+
+void mymd5_tohex(const uint8_t * const bindigest, char * const hexdigest)
+{
+    char *d = hexdigest;
+    for (int i = 0; i < 16; ++i) {
+        *d++ = hexc(bindigest[i] >> 4);
+        *d++ = hexc(bindigest[i] & 0xf);
+    }
+    *d = '\0';  // hexdigest[32] = NUL
+}
+
+void mymd5_bin(const void * const data, const size_t len, char * const digest)
+{
+    MyMd5Ctx ctx;
+    uint8_t bin[16];
+    mymd5_init(&ctx);
+    mymd5_update(&ctx, data, len);
+    mymd5_final(&ctx, bin);
+    mymd5_tohex(bin, digest);
+}
+
+void mymd5(const char * const message, char * const digest)
+{
+    mymd5_bin(message, strlen(message), digest);
 }
 
 char * mymd5_tostr(const char * const message)
@@ -145,3 +198,185 @@ void mymd5_stretch(char * const message, const int n)
     for (int i = 0; i < n; ++i)
         mymd5(message, message);
 }
+
+// Multi-buffer MD5: independent messages in parallel SIMD lanes, one message per lane.
+// The rounds are the same as in mymd5_block(), written once with GCC/clang vector
+// extensions and compiled for 4 (SSE2/NEON), 8 (AVX2) and 16 (AVX-512) lanes.
+// Words are stored as W[word][lane], lanes that have no more chunks are masked out.
+#define MYMD5_MAXLANES 16
+
+typedef void (*mymd5_lanes_t)(uint32_t sum[4][MYMD5_MAXLANES],
+    const uint32_t W[16][MYMD5_MAXLANES], const uint32_t act[MYMD5_MAXLANES]);
+
+#if defined(__GNUC__)
+    #if defined(__x86_64__) || defined(__i386__)
+        #define MYMD5_X86 1
+        #define MYMD5_TARGET(t) __attribute__((target(t)))
+    #else
+        #define MYMD5_X86 0
+        #define MYMD5_TARGET(t)
+    #endif
+
+#define MYMD5_LANES(N, TARGET) \
+TARGET static void mymd5_lanes##N(uint32_t sum[4][MYMD5_MAXLANES], \
+    const uint32_t W[16][MYMD5_MAXLANES], const uint32_t act[MYMD5_MAXLANES]) \
+{ \
+    typedef uint32_t vec __attribute__((vector_size(N * sizeof (uint32_t)))); \
+    vec M[16], S[4], A, B, C, D, F, mask; \
+    for (int j = 0; j < 16; ++j) \
+        memcpy(&M[j], W[j], sizeof (vec)); \
+    for (int j = 0; j < 4; ++j) \
+        memcpy(&S[j], sum[j], sizeof (vec)); \
+    memcpy(&mask, act, sizeof mask); \
+    A = S[0]; B = S[1]; C = S[2]; D = S[3]; \
+    for (uint32_t i = 0; i < 64; ++i) { \
+        uint32_t g; \
+        switch (i >> 4) { \
+            case 0: F = D ^ (B & (C ^ D)); g = i;                 break; \
+            case 1: F = C ^ (D & (B ^ C)); g = (i * 5 + 1) & 0xf; break; \
+            case 2: F = B ^ C ^ D;         g = (i * 3 + 5) & 0xf; break; \
+            default: F = C ^ (B | ~D);     g = (i * 7) & 0xf;     break; \
+        } \
+        F += A + K[i] + M[g]; \
+        A = D; \
+        D = C; \
+        C = B; \
+        B += F << rot[i] | F >> (32 - rot[i]); \
+    } \
+    S[0] += A & mask; \
+    S[1] += B & mask; \
+    S[2] += C & mask; \
+    S[3] += D & mask; \
+    for (int j = 0; j < 4; ++j) \
+        memcpy(sum[j], &S[j], sizeof (vec)); \
+}
+
+MYMD5_LANES( 4, MYMD5_TARGET("sse2"))
+#if MYMD5_X86
+MYMD5_LANES( 8, MYMD5_TARGET("avx2"))
+MYMD5_LANES(16, MYMD5_TARGET("avx512f"))
+#endif
+
+#endif  // __GNUC__
+
+int mymd5_lanes(void)
+{
+#if defined(__GNUC__) && MYMD5_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return 16;
+    if (__builtin_cpu_supports("avx2"))
+        return 8;
+    return __builtin_cpu_supports("sse2") ? 4 : 1;
+#elif defined(__GNUC__)
+    return 4;
+#else
+    return 1;
+#endif
+}
+
+// Chunk b of padded message (len bytes) as 16 little-endian words in column lane of W
+static void mymd5_chunkwords(uint32_t W[16][MYMD5_MAXLANES], const int lane,
+    const uint8_t * const msg, const size_t len, const size_t b, const bool last)
+{
+    uint8_t chunk[64] = {0};
+    const size_t off = b << 6;  // b * 64
+    if (off < len)
+        memcpy(chunk, msg + off, len - off < 64 ? len - off : 64);
+    if (len >= off && len - off < 64)
+        chunk[len - off] = 0x80;
+    if (last) {
+        uint64_t msglen = (uint64_t)len << 3;
+        for (int k = 56; k < 64; ++k, msglen >>= 8)
+            chunk[k] = (uint8_t)msglen;
+    }
+    for (int j = 0; j < 16; ++j) {
+        int k = j << 2;  // j * 4
+        W[j][lane] = (uint32_t)chunk[k + 3] << 24
+                   | (uint32_t)chunk[k + 2] << 16
+                   | (uint32_t)chunk[k + 1] <<  8
+                   | (uint32_t)chunk[k];
+    }
+}
+
+// Hash up to 'lanes' messages at once; digests are written after all messages were read
+static void mymd5_group(const char * const * const messages, char * const * const digests,
+    const int count, mymd5_lanes_t func)
+{
+    size_t len[MYMD5_MAXLANES], nblocks[MYMD5_MAXLANES], maxblocks = 0;
+    uint32_t sum[4][MYMD5_MAXLANES], W[16][MYMD5_MAXLANES], act[MYMD5_MAXLANES];
+
+    for (int i = 0; i < MYMD5_MAXLANES; ++i) {
+        len[i] = i < count ? strlen(messages[i]) : 0;
+        nblocks[i] = i < count ? (len[i] + 8) / 64 + 1 : 0;
+        if (nblocks[i] > maxblocks)
+            maxblocks = nblocks[i];
+        sum[0][i] = 0x67452301;
+        sum[1][i] = 0xefcdab89;
+        sum[2][i] = 0x98badcfe;
+        sum[3][i] = 0x10325476;
+    }
+    for (size_t b = 0; b < maxblocks; ++b) {
+        for (int i = 0; i < count; ++i) {
+            act[i] = b < nblocks[i] ? UINT32_MAX : 0;
+            if (act[i])
+                mymd5_chunkwords(W, i, (const uint8_t *)messages[i], len[i], b, b == nblocks[i] - 1);
+        }
+        for (int i = count; i < MYMD5_MAXLANES; ++i)
+            act[i] = 0;
+        func(sum, (const uint32_t (*)[MYMD5_MAXLANES])W, act);
+    }
+    for (int i = 0; i < count; ++i) {
+        char *d = digests[i];
+        for (int j = 0; j < 4; ++j)
+            for (int k = 0; k < 4; ++k) {
+                const uint8_t byte = (uint8_t)(sum[j][i] >> (k << 3));
+                *d++ = hexc(byte >> 4);
+                *d++ = hexc(byte & 0xf);
+            }
+        *d = '\0';
+    }
+}
+
+void mymd5_batch_lanes(const char * const * const messages, char * const * const digests,
+    const int count, int lanes)
+{
+    mymd5_lanes_t func = NULL;
+#ifdef __GNUC__
+    const int best = mymd5_lanes();
+    if (lanes > best)
+        lanes = best;
+    #if MYMD5_X86
+    if (lanes >= 16) {
+        lanes = 16;
+        func = mymd5_lanes16;
+    } else if (lanes >= 8) {
+        lanes = 8;
+        func = mymd5_lanes8;
+    } else
+    #endif
+    if (lanes >= 4) {
+        lanes = 4;
+        func = mymd5_lanes4;
+    }
+#endif
+    if (!func) {
+        // Scalar fallback
+        for (int i = 0; i < count; ++i)
+            mymd5(messages[i], digests[i]);
+        return;
+    }
+    for (int i = 0; i < count; i += lanes)
+        mymd5_group(messages + i, digests + i, count - i < lanes ? count - i : lanes, func);
+}
+
+void mymd5_batch(const char * const * const messages, char * const * const digests, const int count)
+{
+    mymd5_batch_lanes(messages, digests, count, mymd5_lanes());
+}
+
+void mymd5_stretch_batch(char * const * const messages, const int count, const int n, const int lanes)
+{
+    for (int i = 0; i < n; ++i)
+        mymd5_batch_lanes((const char * const *)messages, messages, count, lanes);
+}
@@ -1,6 +1,35 @@
 #ifndef MYMD5_H
 #define MYMD5_H
 
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint8_t, uint32_t, uint64_t
+
+// Incremental MD5 state, for binary data of any length
+typedef struct mymd5ctx {
+    uint32_t sum[4];   // a0, b0, c0, d0
+    uint64_t msglen;   // total message length in bytes
+    size_t   buflen;   // bytes waiting in buf
+    uint8_t  buf[64];  // partial chunk
+} MyMd5Ctx;
+
+// Start new hash
+void   mymd5_init   (MyMd5Ctx * const ctx);
+
+// Add len bytes of data (may contain zero bytes); call as often as needed
+//   whole 64-byte chunks are processed straight from data without copying
+void   mymd5_update (MyMd5Ctx * const ctx, const void * const data, size_t len);
+
+// Finish hash and store 16-byte binary digest; ctx must be re-initialised for reuse
+void   mymd5_final  (MyMd5Ctx * const ctx, uint8_t * const digest);
+
+// Convert 16-byte binary digest to hex digest
+//   hexdigest buffer size must be >= 33 (32 hex characters + NUL)
+void   mymd5_tohex  (const uint8_t * const bindigest, char * const hexdigest);
+
+// Hex digest of len bytes of binary data
+//   digest buffer size must be >= 33 (32 hex characters + NUL)
+void   mymd5_bin    (const void * const data, const size_t len, char * const digest);
+
 // Ref.: https://en.wikipedia.org/wiki/MD5#Algorithm
 //   message must be null terminated string of any length
 //   digest buffer size must be >= 33 (32 hex characters + NUL)
@@ -27,4 +56,23 @@ void   mymd5_inplace(      char * const message);
 //   stretch should be > 0 and not very large
 void   mymd5_stretch(      char * const message, const int n);
 
+// Number of messages hashed in parallel by mymd5_batch() on this CPU:
+//   16 (AVX-512), 8 (AVX2), 4 (SSE2 or NEON) or 1 (scalar)
+int    mymd5_lanes  (void);
+
+// Hex digests of count independent messages, hashed in parallel SIMD lanes
+//   messages: array of count pointers to null terminated strings
+//   digests : array of count pointers to buffers of size >= 33
+//   digests[i] may be the same as messages[i]
+void   mymd5_batch  (const char * const * const messages, char * const * const digests, const int count);
+
+// Same as mymd5_batch() with at most 'lanes' lanes (1 = scalar mymd5)
+//   lanes is reduced to the nearest supported width <= mymd5_lanes()
+void   mymd5_batch_lanes(const char * const * const messages, char * const * const digests,
+           const int count, int lanes);
+
+// Stretch count independent messages in-place, each N times, using at most 'lanes' lanes
+//   same result for each message as mymd5_stretch(message, n)
+void   mymd5_stretch_batch(char * const * const messages, const int count, const int n, const int lanes);
+
 #endif
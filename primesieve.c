@@ -1,16 +1,18 @@
+// Compile: gcc -std=gnu17 -Wall -O3 primesieve.c primewheel.c -lm
+
 #include <stdio.h>   // printf
 #include <time.h>    // clock, CLOCKS_PER_SEC
-#include <math.h>    // sqrtf, floorf
-#include <stdlib.h>  // calloc
-#include <string.h>  // memcpy
+#include <math.h>    // sqrtf
+#include <stdlib.h>  // malloc, free
+#include <stdint.h>  // uint32_t
+#include "primewheel.h"
 
-#define ISPRIME  (0U)
-#define NOTPRIME (1U)
 #define LIMIT    (1000000U)
-#define HALF     (LIMIT >> 1)
+#define BYTES    ((LIMIT + 29) / 30)
 #define FIVESEC  (CLOCKS_PER_SEC * 5)
 
-static unsigned int rooth;
+static uint32_t *base;  // primes from 7 to sqrt(LIMIT)
+static size_t nbase;
 
 typedef struct {
     unsigned int limit, count;
@@ -38,37 +40,26 @@ static unsigned char isvalid(unsigned int limit, unsigned int count)
     return 0;
 }
 
+// Mod 30 wheel, 8 bits per 30 integers, small primes pre-sieved
 static void sieve(unsigned char *a)
 {
-    unsigned int i, j; //, rooth = ((unsigned int)sqrtf(LIMIT)) >> 1;
-
-    memset(a, ISPRIME, HALF);
-    for (i = 1; i <= rooth; ++i) {
-        if (a[i] == ISPRIME) {
-            for (j = (i * i + i) << 1; j < HALF; j += (i << 1) + 1) {
-                a[j] = NOTPRIME;
-            }
-        }
-    }
+    wheel_sieve(a, 0, BYTES, base, nbase);
 }
 
+// Popcount of the wheel bytes, plus 2, 3, 5
 static unsigned int count(unsigned char *a)
 {
-    unsigned int i, c = LIMIT > 2;
-
-    for (i = 1; i < HALF; ++i) {
-        if (a[i] == ISPRIME) {
-            ++c;
-        }
-    }
-    return c;
+    return (unsigned int)wheel_countprimes(a, 0, BYTES, LIMIT) + (LIMIT > 2) + (LIMIT > 3) + (LIMIT > 5);
 }
 
 int main(void)
 {
-    unsigned char *a = (unsigned char *)malloc(HALF);
+    unsigned char *a = (unsigned char *)malloc(BYTES);
     unsigned int passes = 0;
-    rooth = ((unsigned int)sqrtf(LIMIT)) >> 1;
+    wheel_init();
+    base = wheel_primes((uint32_t)sqrtf(LIMIT), &nbase);
+    if (!a || !base)
+        return 1;
 
     clock_t stop = clock() + FIVESEC;
     do {
@@ -79,5 +70,6 @@ int main(void)
     unsigned int c = count(a);
     printf("%u %u %u %s\n", passes, LIMIT, c, isvalid(LIMIT, c) ? "yes" : "no");
     free(a);
+    free(base);
     return 0;
 }
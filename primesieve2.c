@@ -1,102 +1,125 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <time.h>
 #include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "primewheel.h"
 
 // Based on PrimeCPP.cpp
-// Only store odd numbers.
+// Only store numbers coprime to 30: mod 30 wheel, 8 bits per 30 integers.
 // Reorganize code to minimize some operations
-
-void inline primeset(uint8_t *a, unsigned int prime)
+// Segmented: sieve in L1-sized blocks, spread over threads
+// which take the next block from a shared counter (work queue).
+// Compile: gcc -std=gnu17 -Wall -O3 primesieve2.c primewheel.c -lm -pthread
+// Usage  : ./a.out [limit [threads]]
+
+#define SEGBYTES   (32 * 1024)  // segment size in bytes (30 integers per byte), fits in L1 cache
+#define MAXTHREADS 256
+
+typedef struct sieve {
+    uint64_t limit;         // count primes below limit
+    uint64_t nbytes;        // wheel bytes needed for limit
+    uint64_t nseg;          // number of segments
+    uint32_t *base;         // base primes from 7 to sqrt(limit)
+    size_t nbase;
+    atomic_uint_fast64_t next;   // next segment to sieve
+    atomic_uint_fast64_t count;  // primes found in all segments
+} Sieve;
+
+// Sieve one segment and return the number of primes in it
+static uint64_t sievesegment(const Sieve *s, uint8_t *seg, uint64_t segnum)
 {
-    unsigned int i = prime >> 3;
-    unsigned int bp = prime & 0x7U;
+    const uint64_t lo = segnum * SEGBYTES;
+    const size_t nbytes = lo + SEGBYTES < s->nbytes ? SEGBYTES : (size_t)(s->nbytes - lo);
 
-    a[i] |= (1 << bp);
+    wheel_sieve(seg, lo, nbytes, s->base, s->nbase);
+    return wheel_countprimes(seg, lo, nbytes, s->limit);
 }
 
-uint8_t inline primeget(uint8_t *a, unsigned int prime)
+// Thread: take segments from the queue until none left
+static void *worker(void *arg)
 {
-    unsigned int i = prime >> 3;
-    unsigned int bp = prime & 0x7U;
-
-    return a[i] & (1 << bp);
+    Sieve *s = arg;
+    uint8_t *seg = malloc(SEGBYTES);
+    uint64_t count = 0, segnum;
+
+    if (!seg)
+        return NULL;
+    while ((segnum = atomic_fetch_add(&s->next, 1)) < s->nseg)
+        count += sievesegment(s, seg, segnum);
+    atomic_fetch_add(&s->count, count);
+    free(seg);
+    return NULL;
 }
 
-uint8_t *arralloc(unsigned int numbits)
+// Count primes below limit using nthreads threads
+static uint64_t findprimes(Sieve *s, int nthreads)
 {
-    size_t numints = numbits >> 3;
-
-    if (numbits & 0x7U)
-        numints++;
-    return calloc(numints, 1);
+    pthread_t tid[MAXTHREADS];
+    int started = 0;
+
+    atomic_store(&s->next, 0);
+    atomic_store(&s->count, (s->limit > 2) + (s->limit > 3) + (s->limit > 5));  // 2, 3, 5 are prime
+    if ((uint64_t)nthreads > s->nseg)
+        nthreads = (int)s->nseg;
+    for (int i = 1; i < nthreads; ++i)
+        if (!pthread_create(&tid[started], NULL, worker, s))
+            started++;
+    worker(s);  // this thread also takes part
+    for (int i = 0; i < started; ++i)
+        pthread_join(tid[i], NULL);
+    return atomic_load(&s->count);
 }
 
-void cleararray(uint8_t *a, unsigned int numbits)
+static double walltime(void)
 {
-    size_t numints = numbits >> 3;
-
-    if (numbits & 0x7U)
-        numints++;
-    for (int i = 0; i<numints; i++)
-        a[i] = 0U;
-}
-
-void findprimes(uint8_t *a, int maxints)
-{
-    int maxintsh = maxints >> 1;
-    int factor = 3;
-    int q = (int)sqrt(maxints);
-
-    while (factor <= q) {
-        int factorh = factor >> 1;
-        for (int i = factorh; i < maxintsh; i++) {
-            if (!primeget(a, i)) {
-                factor = (i << 1) + 1;
-                break;
-            }
-        }
-        int f2h = (factor * factor) >> 1;
-        for (int i = f2h; i < maxintsh; i += factor)
-            primeset(a, i);
-        factor += 2;
-    }
-}
-
-int countprimes(uint8_t *a, int maxints)
-{
-    int maxintsh = maxints >> 1;
-    int ncount = 1;
-
-    for (int i = 1; i < maxintsh; i++)
-        if (!primeget(a, i)) {
-        ncount++;
-    }
-    return ncount;
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9 * t.tv_nsec;
 }
 
 int main(int argc, char *argv[])
 {
-    uint8_t *a;
-    clock_t t;
-    int maxints = 1000000;
-    int count;
+    uint64_t maxints = 1000000;
+    int count, nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
 
     if (argc > 1 && argv && argv[1])
-        sscanf(argv[1], "%d", &maxints);
-    a = arralloc(maxints / 2);
-
+        sscanf(argv[1], "%"SCNu64, &maxints);
+    if (argc > 2 && argv[2])
+        sscanf(argv[2], "%d", &nthreads);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAXTHREADS)
+        nthreads = MAXTHREADS;
+
+    Sieve s = {.limit = maxints, .nbytes = wheel_bytes(maxints)};
+    s.nseg = (s.nbytes + SEGBYTES - 1) / SEGBYTES;
+    wheel_init();
+    // Base primes up to floor(sqrt(limit)), at most UINT32_MAX for a 64-bit limit
+    uint64_t root = (uint64_t)sqrtl((long double)maxints);
+    if (root > UINT32_MAX)
+        root = UINT32_MAX;
+    while (root * root > maxints)
+        --root;
+    while (root < UINT32_MAX && (root + 1) * (root + 1) <= maxints)
+        ++root;
+    s.base = wheel_primes((uint32_t)root, &s.nbase);
+    if (!s.base)
+        return 1;
+
+    uint64_t nprimes;
     count = 0;
-    t = clock();
+    double t = walltime();
     do {
-        cleararray(a, maxints / 2);
-        findprimes(a, maxints);
+        nprimes = findprimes(&s, nthreads);
         count++;
-    } while ((double)(clock() - t) / CLOCKS_PER_SEC < 5.);
+    } while (walltime() - t < 5.);
 
-    int nprimes = countprimes(a, maxints);
-    printf("Passes: %d, Limit: %d, Count: %d\n", count, maxints, nprimes);
-    free(a);
+    printf("Passes: %d, Limit: %"PRIu64", Count: %"PRIu64"\n", count, maxints, nprimes);
+    free(s.base);
     return 0;
 }
@@ -0,0 +1,125 @@
+#include <stdlib.h>  // malloc, calloc, free
+#include <string.h>  // memcpy
+#include "primewheel.h"
+
+#define WHEEL    30
+#define PATTERN  (7 * 11 * 13 * 17)  // pre-sieved pattern length in bytes
+#define LASTPRE  17                  // largest pre-sieved prime
+
+// Integer offsets of the 8 bits in a byte, and the reverse lookup
+static const uint8_t residue[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+static const int8_t bitindex[WHEEL] = {
+    -1,  0, -1, -1, -1, -1, -1,  1, -1, -1,
+    -1,  2, -1,  3, -1, -1, -1,  4, -1,  5,
+    -1, -1, -1,  6, -1, -1, -1, -1, -1,  7};
+
+static uint8_t pattern[PATTERN];
+
+size_t wheel_bytes(const uint64_t limit)
+{
+    return (size_t)((limit + WHEEL - 1) / WHEEL);
+}
+
+// Mark all multiples p*q with q >= qmin, q coprime to 30, in bytes [lo, hi)
+// p = 30a + rp, q = 30b + rq  =>  p*q = 30(b*p + a*rq) + rp*rq
+// so for each of the 8 residues rq the byte index steps by p with a constant bit mask.
+static void crossoff(uint8_t *seg, const uint64_t lo, const uint64_t hi, const uint64_t p, const uint64_t qmin)
+{
+    const uint64_t a = p / WHEEL, rp = p % WHEEL;
+
+    for (int j = 0; j < 8; ++j) {
+        const uint64_t prod = rp * residue[j];
+        const uint8_t mask = (uint8_t)(1U << bitindex[prod % WHEEL]);
+        const uint64_t b = qmin > residue[j] ? (qmin - residue[j] + WHEEL - 1) / WHEEL : 0;
+        uint64_t i = b * p + a * residue[j] + prod / WHEEL;
+        if (i < lo)
+            i += (lo - i + p - 1) / p * p;
+        for (; i < hi; i += p)
+            seg[i - lo] |= mask;
+    }
+}
+
+void wheel_init(void)
+{
+    static const uint64_t small[] = {7, 11, 13, 17};
+    for (size_t k = 0; k < sizeof small / sizeof *small; ++k)
+        crossoff(pattern, 0, PATTERN, small[k], 1);
+}
+
+// Copy pre-sieved pattern, fix first byte, then cross off larger primes
+void wheel_sieve(uint8_t *seg, const uint64_t lo, const size_t nbytes,
+    const uint32_t *primes, const size_t nprimes)
+{
+    const uint64_t hi = lo + nbytes;
+
+    for (size_t i = 0, off = (size_t)(lo % PATTERN); i < nbytes; off = 0) {
+        size_t n = PATTERN - off;
+        if (n > nbytes - i)
+            n = nbytes - i;
+        memcpy(seg + i, pattern + off, n);
+        i += n;
+    }
+    if (!lo && nbytes)
+        seg[0] = (seg[0] & 0xe1) | 0x01;  // 7, 11, 13, 17 are prime, 1 is not
+
+    for (size_t k = 0; k < nprimes; ++k) {
+        const uint64_t p = primes[k];
+        if (p <= LASTPRE)
+            continue;
+        if (p * p >= hi * WHEEL)
+            break;
+        crossoff(seg, lo, hi, p, p);
+    }
+}
+
+uint64_t wheel_countprimes(const uint8_t *seg, const uint64_t lo, const size_t nbytes,
+    const uint64_t limit)
+{
+    const uint64_t full = limit / WHEEL;  // bytes below this index are entirely < limit
+    size_t n = full <= lo ? 0 : full - lo < nbytes ? (size_t)(full - lo) : nbytes;
+    uint64_t composites = 0, i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, seg + i, sizeof w);
+        composites += (uint64_t)__builtin_popcountll(w);
+    }
+    for (; i < n; ++i)
+        composites += (uint64_t)__builtin_popcount(seg[i]);
+    uint64_t count = 8 * n - composites;
+
+    // Partial last byte
+    if (full >= lo && full < lo + nbytes)
+        for (int j = 0; j < 8 && full * WHEEL + residue[j] < limit; ++j)
+            count += !(seg[n] & (1U << j));
+    return count;
+}
+
+// Primes from 7 up to and including max, by the unsegmented wheel sieve
+uint32_t *wheel_primes(const uint32_t max, size_t *nprimes)
+{
+    const size_t nbytes = wheel_bytes((uint64_t)max + 1);
+    uint8_t *a = malloc(nbytes ? nbytes : 1);
+    uint32_t *p = malloc((8 * nbytes + 1) * sizeof *p);
+    size_t n = 0;
+
+    if (!a || !p) {
+        free(a);
+        free(p);
+        return NULL;
+    }
+    wheel_sieve(a, 0, nbytes, NULL, 0);
+    for (size_t i = 0; i < nbytes; ++i)
+        for (int j = 0; j < 8; ++j)
+            if (!(a[i] & (1U << j))) {
+                const uint64_t q = i * WHEEL + residue[j];
+                if (q > max)
+                    break;
+                p[n++] = (uint32_t)q;
+                if (q > LASTPRE && q * q < nbytes * WHEEL)
+                    crossoff(a, 0, nbytes, q, q);
+            }
+    free(a);
+    *nprimes = n;
+    return p;
+}
@@ -1,72 +1,518 @@
-#include <stdio.h>    // getline, sscanf, printf
-#include <stdlib.h>   // free
-#include <unistd.h>   // isatty, fileno
-#include <stdbool.h>  // bool
+// Read numeric CSV: every line is a row, fields separated by ',' or ';'
+// (whichever comes first in the first line). Fields are integers or floats;
+// a field that doesn't start with a number is 0, trailing text is ignored.
+// A first line without any numbers is a header with column names.
+//
+// Values are stored per column in arrays that all double in size when full.
+// A column holds 64-bit integers until the first float, then all doubles.
+// Files are mmap'ed, pipes read into memory; with -t the data is split at
+// newlines into parts that are parsed in parallel, then joined per column.
+//
+// Compile: gcc -std=gnu17 -Wall -O3 readcsvfrompipe.c -pthread
+// Usage  : readcsvfrompipe [-s] [-t threads] < file.csv
+//          readcsvfrompipe [-s] [-t threads] file.csv
+//          readcsvfrompipe "1,2,3"
+//            -s : summary per column and parsing speed, instead of all values
+//            -t : number of threads, 0 = all CPUs (default 1)
 
-static bool grow(int ** a, size_t * const size)
+#include <stdio.h>     // printf, fprintf
+#include <stdlib.h>    // malloc, realloc, calloc, free, atoi, strtod
+#include <string.h>    // memcpy, memchr, strlen, strcmp
+#include <stdint.h>    // int64_t, uint64_t
+#include <inttypes.h>  // PRId64
+#include <stdbool.h>   // bool
+#include <math.h>      // NAN
+#include <time.h>      // clock_gettime
+#include <fcntl.h>     // open
+#include <unistd.h>    // isatty, fileno, read, close, sysconf
+#include <sys/stat.h>  // fstat
+#include <sys/mman.h>  // mmap, munmap
+#include <pthread.h>   // pthread_create, pthread_join
+
+#define MINCAP     1024     // first column capacity
+#define MINPART    (1 << 16)  // don't split into smaller parts than this
+#define MAXTHREADS 256
+#define READBLOCK  (1 << 20)
+
+typedef union {
+    int64_t i;
+    double d;
+} Cell;
+
+typedef enum { FIELD_NONE, FIELD_INT, FIELD_FLOAT } FieldType;
+
+typedef struct {
+    Cell *v;       // one value per row
+    bool isfloat;
+} Column;
+
+typedef struct {
+    Column *col;
+    size_t ncols, capcols;
+    size_t nrows, cap;  // rows done, room for rows in every column
+    bool err;           // out of memory
+} Table;
+
+typedef struct {
+    pthread_t tid;
+    const char *data, *end;
+    char delim;
+    Table t;
+} Part;
+
+// Exact powers of ten as double
+static const double pow10tab[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Number at *pp, stops at the first byte that doesn't fit
+static inline FieldType parsenumber(const char **const pp, const char *const end, Cell *const v)
 {
-    static const size_t inc = 32;
-    if (!a || !size)
-        return false;
-    size_t newlen = *size + inc;
-    void *p = realloc(*a, newlen * sizeof **a);
-    if (!p)
+    const char *p = *pp;
+    // Fast path: up to 18 digits, no sign, nothing float-like after
+    {
+        uint64_t m = 0;
+        const char *q = p;
+        for (; q < end && (unsigned char)(*q - '0') <= 9; ++q)
+            m = m * 10 + (uint64_t)(*q - '0');
+        if (q > p && q - p <= 18 && (q == end || (*q != '.' && *q != 'e' && *q != 'E'))) {
+            v->i = (int64_t)m;
+            *pp = q;
+            return FIELD_INT;
+        }
+    }
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    const char *const start = p;
+    bool neg = false, any = false, isfloat = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+    uint64_t m = 0;  // first 19 significant digits
+    int digits = 0, exp10 = 0;
+    for (; p < end && (unsigned char)(*p - '0') <= 9; ++p) {
+        if (digits < 19) {
+            m = m * 10 + (uint64_t)(*p - '0');
+            digits += m != 0;
+        } else
+            ++exp10;
+        any = true;
+    }
+    if (p < end && *p == '.') {
+        isfloat = true;
+        for (++p; p < end && (unsigned char)(*p - '0') <= 9; ++p) {
+            if (digits < 19) {
+                m = m * 10 + (uint64_t)(*p - '0');
+                digits += m != 0;
+                --exp10;
+            }
+            any = true;
+        }
+    }
+    if (!any) {
+        v->i = 0;
+        *pp = p;
+        return FIELD_NONE;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool eneg = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            eneg = *q++ == '-';
+        if (q < end && (unsigned char)(*q - '0') <= 9) {
+            int e = 0;
+            for (; q < end && (unsigned char)(*q - '0') <= 9; ++q)
+                if (e < 100000)
+                    e = e * 10 + (*q - '0');
+            exp10 += eneg ? -e : e;
+            isfloat = true;
+            p = q;
+        }
+    }
+    *pp = p;
+    if (!isfloat && !exp10 && m <= (uint64_t)INT64_MAX + neg) {
+        v->i = neg ? (int64_t)(0 - m) : (int64_t)m;
+        return FIELD_INT;
+    }
+    if (m < (UINT64_C(1) << 53) && exp10 >= -22 && exp10 <= 22) {
+        // Both exact, so one correctly rounded operation (Clinger's fast path)
+        const double x = exp10 < 0 ? (double)m / pow10tab[-exp10] : (double)m * pow10tab[exp10];
+        v->d = neg ? -x : x;
+    } else {
+        // Whole number as a string: input isn't terminated, long fields go on the heap
+        char tmp[128], *buf = tmp;
+        const size_t len = (size_t)(p - start);
+        if (len >= sizeof tmp && !(buf = malloc(len + 1))) {
+            v->d = NAN;
+            return FIELD_FLOAT;
+        }
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        v->d = strtod(buf, NULL);
+        if (buf != tmp)
+            free(buf);
+    }
+    return FIELD_FLOAT;
+}
+
+// Double the room for rows in every column
+static bool grow(Table *const t)
+{
+    const size_t cap = t->cap ? t->cap << 1 : MINCAP;
+    for (size_t c = 0; c < t->ncols; ++c) {
+        Cell *v = realloc(t->col[c].v, cap * sizeof *v);
+        if (!v)
+            return false;
+        t->col[c].v = v;
+    }
+    t->cap = cap;
+    return true;
+}
+
+// Integer column to float
+static void promote(Column *const col, const size_t nrows)
+{
+    for (size_t i = 0; i < nrows; ++i)
+        col->v[i].d = (double)col->v[i].i;
+    col->isfloat = true;
+}
+
+// New column with zeros for all rows so far
+static bool addcolumn(Table *const t)
+{
+    if (t->ncols == t->capcols) {
+        const size_t cap = t->capcols ? t->capcols << 1 : 16;
+        Column *c = realloc(t->col, cap * sizeof *c);
+        if (!c)
+            return false;
+        t->col = c;
+        t->capcols = cap;
+    }
+    Cell *v = calloc(t->cap, sizeof *v);  // int 0 and double 0.0 are both all zero bits
+    if (!v)
         return false;
-    *a = p;
-    *size = newlen;
+    t->col[t->ncols++] = (Column){v, false};
     return true;
 }
 
-static size_t csv2int(int ** a, size_t * size, const char * const line)
+// Value in column c of the current row
+static inline void store(Table *const t, const size_t c, Cell v, const FieldType type)
 {
-    if (!a || !line || !*line)
-        return 0;
-    if (!*a && *size)
-        *size = 0;
-    const char *c = line;
-    while (*c && *c != ',' && *c != ';')
-        ++c;
-    const char delim = *c == ';' ? ';' : ',';
-    c = line;
-    size_t i = 0;
-    while (*c) {
-        if (i >= *size && !grow(a, size))
-            return i;
-        int val;
-        if (sscanf(c, "%d", &val) != 1)
-            val = 0;
-        (*a)[i++] = val;
-        while (*c && *c != delim)
-            ++c;
-        if (*c == delim)
-            ++c;
-    }
-    return i;
+    if (c >= t->ncols && !addcolumn(t)) {
+        t->err = true;
+        return;
+    }
+    Column *const col = &t->col[c];
+    if (type == FIELD_FLOAT) {
+        if (!col->isfloat)
+            promote(col, t->nrows);
+    } else if (col->isfloat)
+        v.d = (double)v.i;
+    col->v[t->nrows] = v;
+}
+
+// All lines from p to end
+static void parse(Table *const t, const char *p, const char *const end, const char delim)
+{
+    while (p < end && !t->err) {
+        if (*p == '\n' || *p == '\r') {
+            ++p;  // skip empty line
+            continue;
+        }
+        if (t->nrows == t->cap && !grow(t)) {
+            t->err = true;
+            break;
+        }
+        size_t c = 0;
+        for (;;) {
+            Cell v;
+            const FieldType type = parsenumber(&p, end, &v);
+            store(t, c++, v, type);
+            while (p < end && *p != delim && *p != '\n')
+                ++p;  // ignore rest of field
+            if (p == end || *p == '\n')
+                break;
+            ++p;  // delimiter
+        }
+        for (; c < t->ncols; ++c)
+            store(t, c, (Cell){0}, FIELD_NONE);  // short row
+        t->nrows++;
+    }
+}
+
+static void freetable(Table *const t)
+{
+    for (size_t i = 0; i < t->ncols; ++i)
+        free(t->col[i].v);
+    free(t->col);
+    *t = (Table){0};
+}
+
+static void *partworker(void *arg)
+{
+    Part *part = arg;
+    parse(&part->t, part->data, part->end, part->delim);
+    return NULL;
+}
+
+// Parse with nthreads in parts that end at a newline, join columns in order
+static Table parseparallel(const char *data, const char *const end, const char delim, int nthreads)
+{
+    const size_t size = (size_t)(end - data);
+    if ((size_t)nthreads > size / MINPART)
+        nthreads = (int)(size / MINPART);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAXTHREADS)
+        nthreads = MAXTHREADS;
+    if (nthreads == 1) {
+        Table t = {0};
+        parse(&t, data, end, delim);
+        return t;
+    }
+
+    static Part part[MAXTHREADS];
+    bool started[MAXTHREADS] = {0};
+    const char *p = data;
+    for (int i = 0; i < nthreads; ++i) {
+        const char *q = i == nthreads - 1 ? end : data + size / (size_t)nthreads * (size_t)(i + 1);
+        if (q < p)
+            q = p;
+        if (q < end) {
+            const char *nl = memchr(q, '\n', (size_t)(end - q));
+            q = nl ? nl + 1 : end;
+        }
+        part[i] = (Part){.data = p, .end = q, .delim = delim};
+        p = q;
+    }
+    for (int i = 1; i < nthreads; ++i)
+        started[i] = !pthread_create(&part[i].tid, NULL, partworker, &part[i]);
+    partworker(&part[0]);
+    for (int i = 1; i < nthreads; ++i)
+        if (started[i])
+            pthread_join(part[i].tid, NULL);
+        else
+            partworker(&part[i]);  // run it here instead
+
+    // Join: every column as long as all rows, float if float in any part
+    Table t = {0};
+    for (int i = 0; i < nthreads; ++i) {
+        t.err |= part[i].t.err;
+        t.nrows += part[i].t.nrows;
+        if (part[i].t.ncols > t.ncols)
+            t.ncols = part[i].t.ncols;
+    }
+    t.capcols = t.ncols;
+    t.cap = t.nrows;
+    t.col = calloc(t.ncols ? t.ncols : 1, sizeof *t.col);
+    if (!t.col)
+        t.err = true;
+    for (size_t c = 0; c < t.ncols && !t.err; ++c) {
+        Column *col = &t.col[c];
+        for (int i = 0; i < nthreads; ++i)
+            col->isfloat |= c < part[i].t.ncols && part[i].t.col[c].isfloat;
+        col->v = malloc((t.nrows ? t.nrows : 1) * sizeof *col->v);
+        if (!col->v) {
+            t.err = true;
+            break;
+        }
+        Cell *dst = col->v;
+        for (int i = 0; i < nthreads; ++i) {
+            const size_t n = part[i].t.nrows;
+            if (c >= part[i].t.ncols)
+                memset(dst, 0, n * sizeof *dst);
+            else if (part[i].t.col[c].isfloat == col->isfloat)
+                memcpy(dst, part[i].t.col[c].v, n * sizeof *dst);
+            else
+                for (size_t j = 0; j < n; ++j)
+                    dst[j].d = (double)part[i].t.col[c].v[j].i;
+            dst += n;
+        }
+    }
+    for (int i = 0; i < nthreads; ++i)
+        freetable(&part[i].t);
+    return t;
+}
+
+// Whole stdin or pipe in memory, size doubles when full
+static char *readall(const int fd, size_t *const len)
+{
+    size_t cap = READBLOCK, n = 0;
+    char *buf = malloc(cap);
+    if (!buf)
+        return NULL;
+    for (;;) {
+        if (n == cap) {
+            char *b = realloc(buf, cap << 1);
+            if (!b) {
+                free(buf);
+                return NULL;
+            }
+            buf = b;
+            cap <<= 1;
+        }
+        const ssize_t r = read(fd, buf + n, cap - n);
+        if (r <= 0)
+            break;
+        n += (size_t)r;
+    }
+    *len = n;
+    return buf;
+}
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
 }
 
 int main(int argc, char *argv[])
 {
-    int *a = NULL;
-    size_t size = 0, range = 0;
+    bool summary = false;
+    int nthreads = 1;
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1] && !(argv[1][1] >= '0' && argv[1][1] <= '9')) {
+        if (!strcmp(argv[1], "-s"))
+            summary = true;
+        else if (!strcmp(argv[1], "-t") && argc > 2) {
+            nthreads = atoi(argv[2]);
+            --argc;
+            ++argv;
+        } else {
+            fprintf(stderr, "Usage: %s [-s] [-t threads] [file.csv | \"csv line\"]\n", argv[0]);
+            return 1;
+        }
+        --argc;
+        ++argv;
+    }
+    if (nthreads <= 0) {
+        const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpu > 0 ? (int)ncpu : 1;
+    }
 
-    if (isatty(fileno(stdin))) {
-        // No pipe or redirect, try command line argument
-        if (argc > 1)
-            range = csv2int(&a, &size, argv[1]);
-    } else {
-        // Input is pipe or redirect to stdin of this program
-        char *buf = NULL;
-        size_t bufsz;
-        if (getline(&buf, &bufsz, stdin) > 0)
-            range = csv2int(&a, &size, buf);
-        free(buf);
+    // Input: pipe or redirect, file name, or CSV text on the command line
+    const char *data = NULL;
+    size_t size = 0;
+    void *map = NULL;
+    char *buf = NULL;
+    int fd = -1;
+    if (!isatty(fileno(stdin)))
+        fd = fileno(stdin);
+    else if (argc > 1 && (fd = open(argv[1], O_RDONLY)) < 0) {
+        data = argv[1];
+        size = strlen(argv[1]);
+    }
+    if (fd >= 0) {
+        struct stat st;
+        if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+            size = (size_t)st.st_size;
+            int flags = MAP_PRIVATE;
+        #ifdef MAP_POPULATE
+            flags |= MAP_POPULATE;  // page in now, not one fault per page while parsing
+        #endif
+            map = mmap(NULL, size, PROT_READ, flags, fd, 0);
+            if (map == MAP_FAILED)
+                map = NULL;
+            data = map;
+        }
+        if (!map) {
+            data = buf = readall(fd, &size);
+            if (!buf) {
+                fprintf(stderr, "Out of memory.\n");
+                return 2;
+            }
+        }
+        if (fd != fileno(stdin))
+            close(fd);
+    }
+    if (!data)
+        return 0;
+    const char *const end = data + size;
+
+    // Delimiter and header from the first line
+    const char *eol = memchr(data, '\n', size);
+    if (!eol)
+        eol = end;
+    char delim = ',';
+    for (const char *c = data; c < eol; ++c)
+        if (*c == ',' || *c == ';') {
+            delim = *c;
+            break;
+        }
+    const char *body = data;
+    bool header = eol > data;
+    for (const char *p = data; p < eol && header; ) {
+        Cell v;
+        header = parsenumber(&p, eol, &v) == FIELD_NONE;
+        while (p < eol && *p != delim)
+            ++p;
+        if (p < eol)
+            ++p;
+    }
+    if (header)
+        body = eol < end ? eol + 1 : end;
+
+    const double t0 = seconds();
+    Table t = parseparallel(body, end, delim, nthreads);
+    const double dt = seconds() - t0;
+    if (t.err) {
+        fprintf(stderr, "Out of memory.\n");
+        return 2;
     }
 
-    if (a) {
-        for (size_t i = 0; i < range; ++i)
-            printf("%zu: %d\n", i, a[i]);
-        free(a);
+    if (summary) {
+        const char *name = data;
+        printf("%zu rows, %zu columns\n", t.nrows, t.ncols);
+        for (size_t c = 0; c < t.ncols; ++c) {
+            const Column *col = &t.col[c];
+            // Column name from header
+            int namelen = 0;
+            if (header && name < eol) {
+                const char *e = name;
+                while (e < eol && *e != delim && *e != '\r')
+                    ++e;
+                namelen = (int)(e - name);
+                printf("%zu %.*s: ", c, namelen, name);
+                name = e < eol ? e + 1 : eol;
+            } else
+                printf("%zu: ", c);
+            if (col->isfloat) {
+                double sum = 0, min = t.nrows ? col->v[0].d : 0, max = min;
+                for (size_t i = 0; i < t.nrows; ++i) {
+                    const double x = col->v[i].d;
+                    sum += x;
+                    min = x < min ? x : min;
+                    max = x > max ? x : max;
+                }
+                printf("float sum=%.17g min=%.17g max=%.17g\n", sum, min, max);
+            } else {
+                int64_t sum = 0, min = t.nrows ? col->v[0].i : 0, max = min;
+                for (size_t i = 0; i < t.nrows; ++i) {
+                    const int64_t x = col->v[i].i;
+                    sum = (int64_t)((uint64_t)sum + (uint64_t)x);  // wraps
+                    min = x < min ? x : min;
+                    max = x > max ? x : max;
+                }
+                printf("int sum=%"PRId64" min=%"PRId64" max=%"PRId64"\n", sum, min, max);
+            }
+        }
+        fprintf(stderr, "%zu bytes in %.3f s = %.2f GB/s (%d thread%s)\n",
+            size, dt, dt > 0 ? size / dt * 1e-9 : 0, nthreads, nthreads == 1 ? "" : "s");
+    } else {
+        // Row by row, numbered as in one long row
+        size_t k = 0;
+        for (size_t r = 0; r < t.nrows; ++r)
+            for (size_t c = 0; c < t.ncols; ++c, ++k) {
+                const Column *col = &t.col[c];
+                if (col->isfloat)
+                    printf("%zu: %.17g\n", k, col->v[r].d);
+                else
+                    printf("%zu: %"PRId64"\n", k, col->v[r].i);
+            }
     }
 
+    freetable(&t);
+    if (map)
+        munmap(map, size);
+    free(buf);
     return 0;
 }
@@ -1,38 +1,218 @@
-#include <stdio.h>    // printf
-#include <stdlib.h>   // malloc
-#include <stdbool.h>  // bool, true
+// Nth prime and prime-counting function pi(x)
+// Sieves segments of a mod 30 wheel up to an analytic bound for the nth prime,
+// and caches the number of primes per segment in an index file. Repeated
+// queries then only sum cached counts and sieve at most one segment.
+// Compile: gcc -std=gnu17 -Wall -O3 sieve.c primewheel.c startstoptimer.c -lm
+// Usage  : ./a.out <n>        nth prime
+//          ./a.out -pi <x>    number of primes <= x
 
-int main(int argc, char *argv[])
+#include <stdio.h>     // printf, fprintf, fopen, fread, fwrite
+#include <stdlib.h>    // malloc, realloc, free, strtoull
+#include <string.h>    // strcmp, memcmp
+#include <stdint.h>    // uint32_t, uint64_t
+#include <inttypes.h>  // PRIu64
+#include <stdbool.h>   // bool, true
+#include <math.h>      // log, sqrtl
+#include "primewheel.h"
+#include "startstoptimer.h"
+
+#define INDEXFILE "sieve.idx"
+#define MAGIC     "PIDX"
+#define SEGBYTES  (32 * 1024)               // segment size in bytes, fits in L1 cache
+#define SEGINTS   (UINT64_C(30) * SEGBYTES)  // integers per segment
+
+static uint32_t *segcount;  // number of primes (other than 2, 3, 5) per segment
+static uint64_t *cumcount;  // cumcount[i] = primes in segments 0..i-1
+static uint64_t nseg, capseg;
+static bool dirty;
+
+static uint32_t *base;      // base primes from 7 to sqrt of highest sieved integer
+static size_t nbase;
+static uint64_t baselimit;
+static uint8_t seg[SEGBYTES];
+
+static bool reserve(uint64_t n)
 {
-    if (argc != 2)
-        return 1;
-    int n = atoi(argv[1]);
-    if (n < 1)
-        return 2;
-    unsigned *p = malloc(n * sizeof *p);
-    if (!p)
-        return 3;
+    if (n <= capseg)
+        return true;
+    uint64_t cap = capseg ? capseg : 1024;
+    while (cap < n)
+        cap <<= 1;
+    uint32_t *c = realloc(segcount, cap * sizeof *c);
+    if (!c)
+        return false;
+    segcount = c;
+    uint64_t *s = realloc(cumcount, (cap + 1) * sizeof *s);
+    if (!s)
+        return false;
+    cumcount = s;
+    capseg = cap;
+    return true;
+}
+
+// Load cached segment counts, silently ignore missing or incompatible file
+static void loadindex(void)
+{
+    FILE *f = fopen(INDEXFILE, "rb");
+    if (!f)
+        return;
+    char magic[4];
+    uint32_t segbytes;
+    uint64_t n;
+    if (fread(magic, sizeof magic, 1, f) == 1 && !memcmp(magic, MAGIC, sizeof magic)
+        && fread(&segbytes, sizeof segbytes, 1, f) == 1 && segbytes == SEGBYTES
+        && fread(&n, sizeof n, 1, f) == 1 && reserve(n)
+        && fread(segcount, sizeof *segcount, n, f) == n)
+        nseg = n;
+    fclose(f);
+    cumcount[0] = 0;
+    for (uint64_t i = 0; i < nseg; ++i)
+        cumcount[i + 1] = cumcount[i] + segcount[i];
+}
+
+static void saveindex(void)
+{
+    if (!dirty)
+        return;
+    FILE *f = fopen(INDEXFILE, "wb");
+    if (!f)
+        return;
+    const uint32_t segbytes = SEGBYTES;
+    fwrite(MAGIC, 4, 1, f);
+    fwrite(&segbytes, sizeof segbytes, 1, f);
+    fwrite(&nseg, sizeof nseg, 1, f);
+    fwrite(segcount, sizeof *segcount, nseg, f);
+    fclose(f);
+}
+
+// Make sure base primes cover all segments below 'segments'
+static bool basecover(uint64_t segments)
+{
+    const uint64_t root = (uint64_t)sqrtl((long double)(segments * SEGINTS)) + 1;
+    if (root <= baselimit)
+        return true;
+    free(base);
+    base = wheel_primes((uint32_t)root, &nbase);
+    baselimit = root;
+    return base != NULL;
+}
+
+static bool sievesegment(uint64_t s)
+{
+    if (!basecover(s + 1))
+        return false;
+    wheel_sieve(seg, s * SEGBYTES, SEGBYTES, base, nbase);
+    return true;
+}
+
+// Extend index to at least 'segments' segments
+static bool extend(uint64_t segments)
+{
+    if (segments <= nseg)
+        return true;
+    if (!reserve(segments) || !basecover(segments))
+        return false;
+    for (; nseg < segments; ++nseg) {
+        sievesegment(nseg);  // base primes already cover all segments
+        segcount[nseg] = (uint32_t)wheel_countprimes(seg, nseg * SEGBYTES, SEGBYTES, UINT64_MAX);
+        cumcount[nseg + 1] = cumcount[nseg] + segcount[nseg];
+    }
+    dirty = true;
+    return true;
+}
+
+// Number of primes <= x
+static uint64_t primepi(uint64_t x)
+{
+    const uint64_t small = (x >= 2) + (x >= 3) + (x >= 5);
+    const uint64_t s = x / SEGINTS;  // segment containing x
+    if (!extend(s) || !sievesegment(s))
+        return 0;
+    return small + cumcount[s] + wheel_countprimes(seg, s * SEGBYTES, SEGBYTES, x + 1);
+}
+
+// Upper bound for the nth prime (Rosser & Schoenfeld, n >= 6)
+static uint64_t nthbound(uint64_t n)
+{
+    if (n < 6)
+        return 13;
+    const double ln = log((double)n);
+    return (uint64_t)((double)n * (ln + log(ln))) + 1;
+}
+
+// Nth prime, or 0 on error
+static uint64_t nthprime(uint64_t n)
+{
+    static const uint64_t small[] = {2, 3, 5};
+    if (n <= 3)
+        return n ? small[n - 1] : 0;
+    const uint64_t m = n - 3;  // nth prime is the mth bit in the wheel
 
-    p[0] = 2;
-    p[1] = 3;
-    if (n < 3)
-        goto done;
-
-    int i = 2, k = 0;
-    for (unsigned q = 5, r = 4;; q += 2) {
-        for (; r <= q; ++k, r = p[k] * p[k]);
-        bool isprime = true;
-        for (int j = 1; isprime && j < k; ++j)
-            isprime = isprime && q % p[j];
-        if (isprime) {
-            p[i++] = q;
-            if (i == n)
-                break;
+    // Find segment where the cumulative count reaches m
+    if (!extend(nthbound(n) / SEGINTS + 1))
+        return 0;
+    uint64_t lo = 0, hi = nseg;  // cumcount[lo] < m <= cumcount[hi]
+    while (hi - lo > 1) {
+        const uint64_t mid = lo + ((hi - lo) >> 1);
+        if (cumcount[mid] < m)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    // Locate prime inside segment
+    static const uint8_t residue[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+    uint64_t left = m - cumcount[lo];
+    if (!sievesegment(lo))
+        return 0;
+    for (size_t i = 0; i < SEGBYTES; ++i) {
+        const unsigned int primes = (uint8_t)~seg[i];
+        const uint64_t k = (uint64_t)__builtin_popcount(primes);
+        if (left > k) {
+            left -= k;
+            continue;
         }
+        for (int j = 0; j < 8; ++j)
+            if ((primes & (1U << j)) && !--left)
+                return (lo * SEGBYTES + i) * 30 + residue[j];
     }
+    return 0;
+}
+
+static int usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s <n>      (nth prime)\n", progname);
+    fprintf(stderr, "       %s -pi <x>  (number of primes <= x)\n", progname);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    const bool pi = argc == 3 && !strcmp(argv[1], "-pi");
+    if (argc != 2 && !pi)
+        return usage(argv[0]);
+    const uint64_t arg = strtoull(argv[pi ? 2 : 1], NULL, 10);
+    if (!pi && arg < 1)
+        return 2;
+
+    wheel_init();
+    if (!reserve(1))
+        return 3;
+    starttimer_q();
+    loadindex();
+    const uint64_t res = pi ? primepi(arg) : nthprime(arg);
+    const double t = stoptimer_us();
+    if (!res && (!pi || arg >= 2))
+        return 3;
 
-done:;
-    printf("P%d = %u\n", n, p[n - 1]);
-    free(p);
+    if (pi)
+        printf("pi(%"PRIu64") = %"PRIu64"\n", arg, res);
+    else
+        printf("P%"PRIu64" = %"PRIu64"\n", arg, res);
+    printf("Time: %.0f us\n", t);
+    saveindex();
+    free(segcount);
+    free(cumcount);
+    free(base);
     return 0;
 }
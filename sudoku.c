@@ -1,33 +1,423 @@
-#include <stdio.h>
-#include <stdbool.h>
+// Sudoku validator and solver
+// Solver keeps bitmasks of used digits per row, column and box, fills in naked
+// and hidden singles until stuck, then branches on the cell with the fewest candidates.
+// Batch mode solves a file with one 81-character puzzle per line on all cores.
+// Puzzle format: digits 1-9, empty cells as '.' or '0', row by row.
+// Any size N^2 x N^2 (boxes of N x N) as exact cover problem with dancing links,
+// also counts solutions. Digits 1-9 then A-Z for 10-35, so N = 2..5.
+// Compile: gcc -std=gnu17 -Wall -O3 sudoku.c dlx.c startstoptimer.c -pthread
+// Usage  : ./a.out <puzzle>                 solve and show one puzzle
+//          ./a.out -b <file> [threads]      solutions to stdout, speed to stderr
+//          ./a.out -x <N> <puzzle> [limit]  exact cover, count up to limit solutions (0 = all, default 2)
+
+#include <stdio.h>      // printf, fprintf, fopen, fread
+#include <stdlib.h>     // malloc, free, atoi
+#include <string.h>     // memcpy, memchr, strlen
+#include <stdint.h>     // uint8_t, uint16_t
+#include <stdbool.h>    // bool
+#include <unistd.h>     // sysconf
+#include <pthread.h>    // pthread_create, pthread_join
+#include <stdatomic.h>  // atomic_fetch_add
+#include "startstoptimer.h"
+#include "dlx.h"
 
 #define N 3
 #define M (N * N)
-static char board[M][M];
-
-static bool isvalid(void)
-{
-    static const int d[M] = {0,0,0,1,1,1,2,2,2};  // i div 3
-    unsigned row[M] = {0}, col[M] = {0}, blk[M] = {0};
-    for (int i = 0; i < M; ++i) {      // rows
-        for (int j = 0; j < M; ++j) {  // columns
-            if (board[i][j] == '.') continue;  // skip empty square
-            const char val = board[i][j] - '0';
-            if (val < 1 || val > M) return false;  // wrong value
-            const unsigned bit = 1u << val;  // set bit mask
-            if (row[i] & bit) return false;  // already in row i?
-            if (col[j] & bit) return false;  // already in column j?
-            const int k = d[i] * N + d[j];   // block index 0..M-1
-            if (blk[k] & bit) return false;  // already in block k?
-            row[i] |= bit;  // set bit for row i
-            col[j] |= bit;  // set bit for column j
-            blk[k] |= bit;  // set bit for block k
+#define CELLS (M * M)
+#define ALL (((1u << M) - 1) << 1)  // bits 1..M = all digits
+#define MAXTHREADS 256
+#define CHUNK 64                    // puzzles per work unit in batch mode
+#define MAXN 5                      // largest box size for exact cover
+
+// Grid of digits (0 = empty) with used digits per unit as bit masks
+typedef struct grid {
+    uint8_t  cell[CELLS];
+    uint16_t row[M], col[M], box[M];  // bit v set = digit v used
+    int free;                         // number of empty cells
+} Grid;
+
+static uint8_t rowof[CELLS], colof[CELLS], boxof[CELLS];
+static uint8_t unit[3 * M][M];  // cells of all rows, columns and boxes
+
+static void init(void)
+{
+    for (int i = 0; i < CELLS; ++i) {
+        rowof[i] = (uint8_t)(i / M);
+        colof[i] = (uint8_t)(i % M);
+        boxof[i] = (uint8_t)(i / M / N * N + i % M / N);
+    }
+    int n[3 * M] = {0};
+    for (int i = 0; i < CELLS; ++i) {
+        unit[rowof[i]][n[rowof[i]]++] = (uint8_t)i;
+        unit[M + colof[i]][n[M + colof[i]]++] = (uint8_t)i;
+        unit[2 * M + boxof[i]][n[2 * M + boxof[i]]++] = (uint8_t)i;
+    }
+}
+
+// 16 lanes of 16-bit digit masks, one lane per unit (0 = empty cell)
+typedef uint16_t vec __attribute__((vector_size(16 * sizeof (uint16_t))));
+
+// Check puzzle of CELLS characters. Per cell the digit becomes a single bit,
+// so a unit has no duplicates if and only if the sum of its bits equals their OR.
+// Masks are stored three times: lane = column, lane = row, lane = box, and
+// all units of one kind are checked at once by adding and OR'ing M vectors.
+static bool isvalid(const char *s)
+{
+    vec byrow[M] = {0}, bycol[M] = {0}, bybox[M] = {0};
+    for (int i = 0; i < CELLS; ++i) {
+        if (s[i] == '.' || s[i] == '0') continue;  // skip empty square
+        const int val = s[i] - '0';
+        if (val < 1 || val > M) return false;  // wrong value
+        const uint16_t bit = (uint16_t)(1u << val);
+        byrow[rowof[i]][colof[i]] = bit;  // lane = column
+        bycol[colof[i]][rowof[i]] = bit;  // lane = row
+        bybox[rowof[i] % N * N + colof[i] % N][boxof[i]] = bit;  // lane = box
+    }
+    vec o[3] = {0}, a[3] = {0};
+    for (int i = 0; i < M; ++i) {
+        o[0] |= byrow[i]; a[0] += byrow[i];
+        o[1] |= bycol[i]; a[1] += bycol[i];
+        o[2] |= bybox[i]; a[2] += bybox[i];
+    }
+    const vec dup = (o[0] != a[0]) | (o[1] != a[1]) | (o[2] != a[2]);
+    for (int i = 0; i < 16; ++i)
+        if (dup[i]) return false;
+    return true;
+}
+
+static inline unsigned int candidates(const Grid *g, const int i)
+{
+    return ALL & ~(unsigned int)(g->row[rowof[i]] | g->col[colof[i]] | g->box[boxof[i]]);
+}
+
+static inline void place(Grid *g, const int i, const int v)
+{
+    const uint16_t bit = (uint16_t)(1u << v);
+    g->cell[i] = (uint8_t)v;
+    g->row[rowof[i]] |= bit;
+    g->col[colof[i]] |= bit;
+    g->box[boxof[i]] |= bit;
+    g->free--;
+}
+
+// Grid from puzzle string, false if digits clash
+static bool load(Grid *g, const char *s)
+{
+    *g = (Grid){.free = CELLS};
+    for (int i = 0; i < CELLS; ++i)
+        if (s[i] >= '1' && s[i] <= '0' + M) {
+            const int v = s[i] - '0';
+            if (!(candidates(g, i) & (1u << v)))
+                return false;
+            place(g, i, v);
+        }
+    return true;
+}
+
+// Fill in naked singles (one candidate left in a cell) and hidden singles
+// (digit fits in only one cell of a unit) until nothing changes.
+// Returns false on contradiction.
+static bool propagate(Grid *g)
+{
+    for (bool progress = true; progress && g->free; ) {
+        progress = false;
+        for (int i = 0; i < CELLS; ++i)
+            if (!g->cell[i]) {
+                const unsigned int c = candidates(g, i);
+                if (!c)
+                    return false;
+                if (!(c & (c - 1))) {
+                    place(g, i, __builtin_ctz(c));
+                    progress = true;
+                }
+            }
+        for (int u = 0; u < 3 * M && g->free; ++u) {
+            unsigned int once = 0, twice = 0, used = 0;
+            for (int k = 0; k < M; ++k) {
+                const int i = unit[u][k];
+                if (g->cell[i])
+                    used |= 1u << g->cell[i];
+                else {
+                    const unsigned int c = candidates(g, i);
+                    twice |= once & c;
+                    once |= c;
+                }
+            }
+            if ((once | used) != ALL)
+                return false;  // digit has nowhere to go
+            for (unsigned int hidden = once & ~twice; hidden; hidden &= hidden - 1) {
+                const int v = __builtin_ctz(hidden);
+                int k = 0;
+                while (k < M && (g->cell[unit[u][k]] || !(candidates(g, unit[u][k]) & (1u << v))))
+                    ++k;
+                if (k == M)
+                    return false;  // other hidden single took its place
+                place(g, unit[u][k], v);
+                progress = true;
+            }
         }
     }
     return true;
 }
 
-int main(void)
+// Depth-first search, branching on the cell with the fewest candidates
+static bool solve(Grid *g)
 {
+    if (!propagate(g))
+        return false;
+    if (!g->free)
+        return true;
+    int best = -1, min = M + 1;
+    for (int i = 0; i < CELLS && min > 2; ++i)
+        if (!g->cell[i]) {
+            const int n = __builtin_popcount(candidates(g, i));
+            if (n < min) {
+                min = n;
+                best = i;
+            }
+        }
+    for (unsigned int c = candidates(g, best); c; c &= c - 1) {
+        Grid h = *g;
+        place(&h, best, __builtin_ctz(c));
+        if (solve(&h)) {
+            *g = h;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Solve puzzle string s, solution to out (CELLS characters)
+// Returns 1 = solved, 0 = no solution, -1 = invalid puzzle
+static int solvestr(const char *s, char *out)
+{
+    Grid g;
+    if (!isvalid(s) || !load(&g, s))
+        return -1;
+    if (!solve(&g))
+        return 0;
+    for (int i = 0; i < CELLS; ++i)
+        out[i] = (char)('0' + g.cell[i]);
+    return 1;
+}
+
+// Batch mode
+static char **puzzle;    // start of each line
+static char *solution;   // CELLS + 1 characters per puzzle, "" = unsolved
+static int *status;
+static size_t npuzzles;
+static atomic_size_t nextchunk;
+
+static void *worker(void *arg)
+{
+    (void)arg;
+    size_t c;
+    while ((c = atomic_fetch_add(&nextchunk, 1) * CHUNK) < npuzzles)
+        for (size_t i = c; i < c + CHUNK && i < npuzzles; ++i) {
+            char *out = solution + i * (CELLS + 1);
+            status[i] = solvestr(puzzle[i], out);
+            out[status[i] > 0 ? CELLS : 0] = '\0';
+        }
+    return NULL;
+}
+
+static int batch(const char *name, int nthreads)
+{
+    FILE *f = fopen(name, "rb");
+    if (!f) {
+        fprintf(stderr, "File not found: %s\n", name);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc((size_t)size + 1);
+    if (!text || fread(text, 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        free(text);
+        return 2;
+    }
+    fclose(f);
+    text[size] = '\0';
+
+    // Lines of at least CELLS characters, shorter lines are skipped
+    size_t cap = 1024;
+    puzzle = malloc(cap * sizeof *puzzle);
+    for (char *p = text, *eol; puzzle && p < text + size; p = eol + 1) {
+        if (!(eol = memchr(p, '\n', (size_t)(text + size - p))))
+            eol = text + size;
+        if (eol - p < CELLS)
+            continue;
+        if (npuzzles == cap) {
+            char **tmp = realloc(puzzle, (cap <<= 1) * sizeof *puzzle);
+            if (!tmp) {
+                free(puzzle);
+                puzzle = NULL;
+                break;
+            }
+            puzzle = tmp;
+        }
+        puzzle[npuzzles++] = p;
+    }
+    solution = malloc(npuzzles * (CELLS + 1) + 1);
+    status = malloc(npuzzles * sizeof *status + 1);
+    if (!puzzle || !solution || !status) {
+        free(text);
+        free(puzzle);
+        free(solution);
+        free(status);
+        return 2;
+    }
+
+    starttimer_q();
+    pthread_t tid[MAXTHREADS];
+    int started = 0;
+    for (int i = 1; i < nthreads; ++i)
+        if (!pthread_create(&tid[started], NULL, worker, NULL))
+            started++;
+    worker(NULL);
+    for (int i = 0; i < started; ++i)
+        pthread_join(tid[i], NULL);
+    const double t = stoptimer_s();
+
+    size_t solved = 0, invalid = 0;
+    for (size_t i = 0; i < npuzzles; ++i) {
+        solved += status[i] > 0;
+        invalid += status[i] < 0;
+        puts(status[i] > 0 ? solution + i * (CELLS + 1) : status[i] ? "invalid" : "unsolvable");
+    }
+    fprintf(stderr, "Puzzles   : %zu (%zu solved, %zu unsolvable, %zu invalid)\n",
+        npuzzles, solved, npuzzles - solved - invalid, invalid);
+    fprintf(stderr, "Threads   : %d\n", started + 1);
+    fprintf(stderr, "Time      : %.3f s\n", t);
+    fprintf(stderr, "Puzzles/s : %.0f\n", t > 0 ? (double)npuzzles / t : 0);
+    free(text);
+    free(puzzle);
+    free(solution);
+    free(status);
+    return 0;
+}
+
+// Exact cover: one column per constraint (cell filled, digit in row, in column,
+// in box), one row per possible digit in a cell with a 1 in each of its 4 columns.
+// Givens only get the row of their own digit. Returns number of solutions found,
+// the first one in out (m * m values), or -1 for invalid characters.
+static long exactcover(const int n, const char *s, const size_t limit, uint8_t *out)
+{
+    const int m = n * n, cells = m * m;
+    uint8_t *given = malloc((size_t)cells);
+    int *sol = malloc((size_t)cells * 4 * sizeof *sol);
+    Dlx *x = dlx_new(4 * cells, 4 * cells * m);
+    if (!given || !sol || !x) {
+        free(given);
+        free(sol);
+        dlx_free(x);
+        return -1;
+    }
+    for (int i = 0; i < cells; ++i) {
+        const char c = s[i];
+        const int v = c >= '1' && c <= '9' ? c - '0' : c >= 'A' && c <= 'Z' ? c - 'A' + 10
+            : c >= 'a' && c <= 'z' ? c - 'a' + 10 : c == '.' || c == '0' ? 0 : -1;
+        if (v < 0 || v > m) {
+            free(given);
+            free(sol);
+            dlx_free(x);
+            return -1;
+        }
+        given[i] = (uint8_t)v;
+    }
+    for (int i = 0; i < cells; ++i) {
+        const int r = i / m, c = i % m, b = r / n * n + c / n;
+        for (int d = 0; d < m; ++d)
+            if (!given[i] || given[i] == d + 1) {
+                const int col[4] = {i, cells + r * m + d, 2 * cells + c * m + d, 3 * cells + b * m + d};
+                dlx_addrow(x, col, 4, i * m + d);
+            }
+    }
+    int len;
+    const size_t count = dlx_solve(x, limit, sol, &len);
+    for (int i = 0; count && i < len; ++i)
+        out[sol[i] / m] = (uint8_t)(sol[i] % m + 1);
+    free(given);
+    free(sol);
+    dlx_free(x);
+    return (long)count;
+}
+
+// Show grid of n^2 x n^2 values 1..n^2
+static void printgrid(const int n, const uint8_t *val)
+{
+    const int m = n * n;
+    for (int i = 0; i < m; ++i) {
+        if (i && !(i % n)) {
+            for (int b = 0; b < n; ++b) {
+                for (int k = 2 * n - 1 + (b > 0) + (b < n - 1); k; --k)
+                    putchar('-');
+                putchar(b < n - 1 ? '+' : '\n');
+            }
+        }
+        for (int j = 0; j < m; ++j) {
+            const int v = val[i * m + j];
+            printf("%s%c", j ? j % n ? " " : " | " : "", v < 10 ? '0' + v : 'A' + v - 10);
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    init();
+    if (argc >= 3 && argv[1][0] == '-' && argv[1][1] == 'b') {
+        int nthreads = argc > 3 ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (nthreads < 1)
+            nthreads = 1;
+        if (nthreads > MAXTHREADS)
+            nthreads = MAXTHREADS;
+        return batch(argv[2], nthreads);
+    }
+    if (argc >= 4 && argv[1][0] == '-' && argv[1][1] == 'x') {
+        const int n = atoi(argv[2]);
+        const size_t limit = argc > 4 ? strtoull(argv[4], NULL, 10) : 2;
+        if (n < 2 || n > MAXN || strlen(argv[3]) < (size_t)(n * n * n * n)) {
+            fprintf(stderr, "Need N = 2..%d and a puzzle of N^4 characters.\n", MAXN);
+            return 1;
+        }
+        uint8_t out[MAXN * MAXN * MAXN * MAXN];
+        const long count = exactcover(n, argv[3], limit, out);
+        if (count < 0) {
+            puts("Invalid puzzle.");
+            return 2;
+        }
+        if (!count) {
+            puts("No solution.");
+            return 3;
+        }
+        printgrid(n, out);
+        const bool stopped = limit && (size_t)count == limit;  // search ended at the limit
+        printf("Solutions: %s%ld%s\n", stopped ? "at least " : "", count,
+            count == 1 && !stopped ? " (unique)" : "");
+        return 0;
+    }
+    if (argc != 2 || strlen(argv[1]) < CELLS) {
+        fprintf(stderr, "Usage: %s <puzzle of %d characters>\n", argv[0], CELLS);
+        fprintf(stderr, "       %s -b <file> [threads]\n", argv[0]);
+        fprintf(stderr, "       %s -x <N> <puzzle of N^4 characters> [max solutions, 0 = all]\n", argv[0]);
+        return 1;
+    }
+
+    char out[CELLS];
+    const int res = solvestr(argv[1], out);
+    if (res < 0) {
+        puts("Invalid puzzle.");
+        return 2;
+    }
+    if (!res) {
+        puts("No solution.");
+        return 3;
+    }
+    uint8_t val[CELLS];
+    for (int i = 0; i < CELLS; ++i)
+        val[i] = (uint8_t)(out[i] - '0');
+    printgrid(N, val);
     return 0;
 }
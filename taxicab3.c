@@ -1,39 +1,247 @@
-#include <stdio.h>   // printf
-#include <stdlib.h>  // qsort
+// Numbers that are the sum of two positive cubes in at least k different ways.
+// The first one is the taxicab number Ta(k): 2, 1729, 87539319, 6963472309248, ...
+// Ref.: https://en.wikipedia.org/wiki/Taxicab_number
+//
+// All cube sums a^3 + b^3 (a <= b) come out in increasing order from a min-heap
+// with one entry per a, so equal sums are next to each other and memory is
+// O(N) for b up to N, instead of storing and sorting all N^2/2 sums.
+// Sums are 128-bit. Values are searched in windows of doubling size, every
+// window split over the threads in ranges with about the same number of sums.
+//
+// Compile: gcc -std=gnu17 -Wall -O3 taxicab3.c -lm -pthread
+// Usage  : taxicab3 [k [count [threads]]]
+//            k       : number of ways, default 2
+//            count   : how many numbers to find, default 100
+//            threads : default = number of CPUs
 
-#define N 213U
-#define M ((N * (N + 1U)) >> 1U)
+#include <stdio.h>     // printf, fprintf
+#include <stdlib.h>    // atoi, malloc, realloc, free
+#include <stdint.h>    // uint32_t, uint64_t
+#include <inttypes.h>  // PRIu64
+#include <math.h>      // cbrtl, powl
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // sysconf
+#include <pthread.h>   // pthread_create, pthread_join
+
+#define MAXWAYS 16  // remember this many pairs per number, more are only counted
+#define MAXTHREADS 256
+#define FIRSTWINDOW 4096
+
+typedef unsigned __int128 u128;
+
+typedef struct {
+    u128 sum;        // a^3 + b^3
+    uint32_t a, b;
+} Entry;
 
 typedef struct {
-    unsigned int x, a, b;
-} Triple;
+    u128 x;
+    int ways;
+    uint32_t a[MAXWAYS], b[MAXWAYS];
+} Found;
+
+typedef struct {
+    pthread_t tid;
+    u128 lo, hi;       // in: search x in [lo, hi)
+    int k;
+    Found *found;      // out: numbers with at least k ways, in increasing order
+    size_t len, cap;
+    uint64_t sums;     // cube sums visited
+    int err;
+} Part;
+
+static inline u128 cube(const uint64_t n)
+{
+    return (u128)n * n * n;
+}
 
-static Triple sum[M] = {0};
+// Largest r with r^3 <= x
+static uint64_t icbrt(const u128 x)
+{
+    uint64_t r = (uint64_t)cbrtl((long double)x);
+    while (r && cube(r) > x)
+        --r;
+    while (cube(r + 1) <= x)
+        ++r;
+    return r;
+}
+
+static void siftdown(Entry *heap, const size_t len, size_t i)
+{
+    const Entry e = heap[i];
+    for (size_t j; (j = 2 * i + 1) < len; i = j) {
+        if (j + 1 < len && heap[j + 1].sum < heap[j].sum)
+            ++j;
+        if (heap[j].sum >= e.sum)
+            break;
+        heap[i] = heap[j];
+    }
+    heap[i] = e;
+}
 
-static int cmp(const void *a, const void *b)
+// Add number x to the results of this part
+static int keep(Part *p, const u128 x, const int ways, const Entry *pair, const int npairs)
 {
-    const unsigned int p = *(const unsigned int*)a;
-    const unsigned int q = *(const unsigned int*)b;
-    return (q < p) - (p < q);
+    if (p->len == p->cap) {
+        const size_t cap = p->cap ? p->cap << 1 : 64;
+        Found *f = realloc(p->found, cap * sizeof *f);
+        if (!f)
+            return 0;
+        p->found = f;
+        p->cap = cap;
+    }
+    Found *f = &p->found[p->len++];
+    f->x = x;
+    f->ways = ways;
+    // Pairs came out of the heap in any order: sort by a
+    for (int i = 0; i < npairs; ++i) {
+        int j = i;
+        for (; j > 0 && f->a[j - 1] > pair[i].a; --j) {
+            f->a[j] = f->a[j - 1];
+            f->b[j] = f->b[j - 1];
+        }
+        f->a[j] = pair[i].a;
+        f->b[j] = pair[i].b;
+    }
+    return 1;
 }
 
-int main(void)
+// Stream all cube sums in [lo, hi) in increasing order
+static void *search(void *arg)
 {
-    unsigned int i, j, k = 0, n = 0;
+    Part *p = arg;
+    // One row per a with a <= b, starting at the first b where a^3 + b^3 >= lo
+    const size_t rows = p->hi > 2 ? icbrt((p->hi - 1) / 2) : 0;
+    Entry *heap = malloc((rows + 1) * sizeof *heap);
+    if (!heap) {
+        p->err = 1;
+        return NULL;
+    }
+    size_t len = 0;
+    for (uint64_t a = 1; a <= rows; ++a) {
+        const u128 a3 = cube(a), need = p->lo > a3 ? p->lo - a3 : 0;
+        uint64_t b = icbrt(need);
+        if (cube(b) < need)
+            ++b;
+        if (b < a)
+            b = a;
+        heap[len++] = (Entry){a3 + cube(b), (uint32_t)a, (uint32_t)b};
+    }
+    for (size_t i = len / 2; i-- > 0; )
+        siftdown(heap, len, i);
 
-    for (j = 1; j < N; ++j) {
-        sum[j] = (Triple){j * j * j, 0, j};
+    Entry pair[MAXWAYS];
+    while (len && heap[0].sum < p->hi) {
+        const u128 x = heap[0].sum;
+        int ways = 0;
+        // Every row with this sum: note the pair, then move on to the next b
+        do {
+            if (ways < MAXWAYS)
+                pair[ways] = heap[0];
+            ++ways;
+            const uint64_t b = heap[0].b;
+            heap[0].sum += (u128)(3 * b) * (b + 1) + 1;  // (b+1)^3 - b^3
+            heap[0].b = (uint32_t)(b + 1);
+            siftdown(heap, len, 0);
+        } while (heap[0].sum == x);
+        p->sums += (uint64_t)ways;
+        if (ways >= p->k && !keep(p, x, ways, pair, ways < MAXWAYS ? ways : MAXWAYS)) {
+            p->err = 1;
+            break;
+        }
     }
-    k = N;
-    for (i = 1; i < N; ++i)
-        for (j = i; j < N; ++j)
-            sum[k++] = (Triple){sum[i].x + sum[j].x, i, j};
+    free(heap);
+    return NULL;
+}
+
+// Unsigned 128-bit to decimal
+static const char *u128str(u128 x)
+{
+    static char buf[40];
+    char *s = buf + sizeof buf - 1;
+    *s = '\0';
+    do {
+        *--s = (char)('0' + (int)(x % 10));
+        x /= 10;
+    } while (x);
+    return s;
+}
 
-    qsort(sum, M, sizeof(Triple), cmp);
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
 
-    for (i = 0; i < M - 1; ++i)
-        if (sum[i].x == sum[i + 1].x)
-            printf("%3u: %8u = %3u^3 + %3u^3 = %3u^3 + %3u^3\n", ++n, sum[i].x, sum[i].a, sum[i].b, sum[i + 1].a, sum[i + 1].b);
+int main(int argc, char *argv[])
+{
+    const int k = argc > 1 ? atoi(argv[1]) : 2;
+    const long count = argc > 2 ? atol(argv[2]) : 100;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = argc > 3 ? atoi(argv[3]) : (int)(ncpu > 0 ? ncpu : 1);
+    if (k < 1 || count < 1) {
+        fprintf(stderr, "Usage: %s [k [count [threads]]]\n", argv[0]);
+        return 1;
+    }
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAXTHREADS)
+        nthreads = MAXTHREADS;
 
+    static Part part[MAXTHREADS];
+    const double t0 = seconds();
+    uint64_t sums = 0;
+    long n = 0;
+    for (u128 lo = 1, hi = FIRSTWINDOW; n < count; lo = hi, hi <<= 1) {
+        if (hi <= lo) {
+            fprintf(stderr, "Out of range.\n");
+            return 2;
+        }
+        // About x^(2/3) cube sums below x: split [lo, hi) evenly on that scale
+        const long double l = powl((long double)lo, 2.0L / 3), h = powl((long double)hi, 2.0L / 3);
+        u128 start = lo;
+        for (int i = 0; i < nthreads; ++i) {
+            u128 end = i == nthreads - 1 ? hi : (u128)powl(l + (h - l) * (i + 1) / nthreads, 1.5L);
+            if (end < start)
+                end = start;
+            if (end > hi)
+                end = hi;
+            free(part[i].found);
+            part[i] = (Part){.lo = start, .hi = end, .k = k};
+            start = end;
+        }
+        int started[MAXTHREADS] = {0};
+        for (int i = 1; i < nthreads; ++i)
+            started[i] = !pthread_create(&part[i].tid, NULL, search, &part[i]);
+        search(&part[0]);
+        for (int i = 1; i < nthreads; ++i)
+            if (started[i])
+                pthread_join(part[i].tid, NULL);
+            else
+                search(&part[i]);  // run it here instead
+        // Parts are consecutive ranges, so results are in order
+        for (int i = 0; i < nthreads; ++i) {
+            if (part[i].err) {
+                fprintf(stderr, "Out of memory.\n");
+                return 3;
+            }
+            sums += part[i].sums;
+            for (size_t j = 0; j < part[i].len && n < count; ++j) {
+                const Found *f = &part[i].found[j];
+                printf("%3ld: %s", ++n, u128str(f->x));
+                for (int w = 0; w < f->ways && w < MAXWAYS; ++w)
+                    printf(" = %u^3 + %u^3", f->a[w], f->b[w]);
+                if (f->ways > MAXWAYS)
+                    printf(" (%d ways)", f->ways);
+                printf("\n");
+            }
+        }
+    }
+    const double t = seconds() - t0;
+    fprintf(stderr, "%d thread%s, %.3f s, %"PRIu64" cube sums (%.0f M/s)\n",
+        nthreads, nthreads == 1 ? "" : "s", t, sums, t > 0 ? sums / t * 1e-6 : 0);
+    for (int i = 0; i < nthreads; ++i)
+        free(part[i].found);
     return 0;
 }
@@ -2,10 +2,23 @@
 // https://www.reddit.com/r/adventofcode/comments/128t3c6/puzzle_implement_a_fantasy_computer_to_find_out/
 // Puzzle designed by https://www.reddit.com/user/codeobserver for https://codeguppy.com
 // Solution by E. Dronkert https://github.com/ednl
+// Compile: gcc -std=gnu17 -Wall -O3 vm-codeobserver.c -pthread
+// Usage  : ./a.out                              run the puzzle program
+//          ./a.out -b <file> [cycles [threads]]  run every CSV line of file as a program
+// run() decodes the program once into instruction records with register operands
+// already resolved to pointers and dispatches them with computed goto (GCC/Clang).
+// tick() is the reference interpreter that decodes every cycle; both give the
+// same output, final state and tick/tock counts.
 
 #include <stdio.h>    // printf, sscanf
-#include <stdlib.h>   // calloc, free
+#include <stdlib.h>   // calloc, malloc, free
+#include <string.h>   // memcmp, memcpy
 #include <stdbool.h>  // bool
+#include <limits.h>   // INT_MAX
+#include <time.h>     // clock_gettime
+#include <unistd.h>   // sysconf
+#include <pthread.h>  // pthread_create, pthread_join
+#include <stdatomic.h>
 
 // Default VM setup parameters
 #define MEMORYSIZE  64  // actually used by puzzle: 50
@@ -34,6 +47,19 @@
 #define ERR_REGISTER_INDEX    7
 #define ERR_INTERNAL_PARCOUNT 8
 #define ERR_INTERNAL_PARMODE  9
+#define ERR_CYCLE_BUDGET     10  // batch mode: not halted within cycle budget
+#define ERR_PARSE            11  // batch mode: program line not valid
+
+static const char *errname[] = {
+    "ERR_OK", "ERR_NULLPOINTER", "ERR_INVALID_OPCODE", "ERR_PC_UNDERFLOW", "ERR_PC_OVERFLOW",
+    "ERR_STACK_FULL", "ERR_STACK_EMPTY", "ERR_REGISTER_INDEX", "ERR_INTERNAL_PARCOUNT",
+    "ERR_INTERNAL_PARMODE", "ERR_CYCLE_BUDGET", "ERR_PARSE"};
+#define ERRCOUNT (sizeof errname / sizeof *errname)
+
+// Batch mode defaults
+#define BUDGET     1000000  // max clock cycles per program
+#define MAXTHREADS 256
+#define CHUNK      16       // programs per work unit
 
 // Program code
 static const char *input = "11,0,10,42,6,255,30,0,11,0,0,11,1,1,11,3,1,60,1,10,2,0,20,2,1,60,2,10,0,1,10,1,2,11,2,1,20,3,2,31,2,30,2,41,3,2,19,31,0,50";
@@ -59,11 +85,30 @@ static Instr assembly[26][6] = {
     {{0},{0},{0},{0},{0},{255,0,0,"HALT"}}  // no opcodes in cols 0-4
 };
 
+// Decoded instruction at one memory address (jumps may land anywhere, so every
+// address gets a record). Static errors become an OP_ERROR record that fails the
+// same way as tick() would, at run time.
+typedef enum {
+    OP_MOVR, OP_MOVV, OP_ADD, OP_SUB, OP_PUSH, OP_POP, OP_JP, OP_JL, OP_CALL, OP_RET,
+    OP_PRINT, OP_HALT, OP_ERROR, OP_END
+} OpIndex;
+
+typedef struct {
+    int *a, *b;        // resolved register operands
+    int val;           // immediate value or jump address
+    int next;          // address of next instruction
+    int err, errpc;    // OP_ERROR: error code and pc after failing
+    signed char stackdir;
+    unsigned char op;  // OpIndex
+} Decoded;
+
 typedef struct {
     int *mem, *stack, *reg;
     int memsize, progsize, stacksize, regcount;
     int pc, sp, tick, tock, retval;  // program counter, stack pointer, clock, result
     bool halted, silent;
+    Decoded *code;  // progsize + 1 records, last one = past the end
+    int *image;     // copy of program memory at the time of decoding
 } VirtualMachine;
 
 static int fieldcount(const char * const csvline)
@@ -78,9 +123,28 @@ static int fieldcount(const char * const csvline)
     return fields;
 }
 
+// Parse program into memory, true if it has the expected number of fields
+static bool loadprog(VirtualMachine * vm, const char * const csvline, const int fields)
+{
+    const char *c = csvline;
+    while (*c != '\0' && vm->progsize < vm->memsize) {
+        int val;
+        if (sscanf(c, "%d", &val) != 1)
+            return false;
+        vm->mem[vm->progsize++] = val;
+        while (*c != '\0' && *c != ',')
+            ++c;
+        if (*c == ',')
+            ++c;
+    }
+    return vm->progsize == fields;
+}
+
 static void * del_vm(VirtualMachine ** vm)
 {
     if (vm && *vm) {
+        free((*vm)->code);
+        free((*vm)->image);
         free((*vm)->mem);
         free((*vm)->stack);
         free((*vm)->reg);
@@ -105,18 +169,7 @@ static VirtualMachine * new_vm(const char * const csvline)
     vm->memsize = memsize;
     vm->stacksize = STACKSIZE;
     vm->regcount = REGISTERS;
-    const char *c = csvline;
-    while (*c != '\0' && vm->progsize < vm->memsize) {
-        int val;
-        if (sscanf(c, "%d", &val) != 1)
-            return del_vm(&vm);
-        vm->mem[vm->progsize++] = val;
-        while (*c != '\0' && *c != ',')
-            ++c;
-        if (*c == ',')
-            ++c;
-    }
-    if (vm->progsize != progsize)
+    if (!loadprog(vm, csvline, progsize))
         return del_vm(&vm);
     return vm;
 }
@@ -227,18 +280,362 @@ static int tick(VirtualMachine * vm)
     return ERR_OK;
 }
 
-static int run(VirtualMachine * vm)
+// Decode instruction at every address with the same checks as tick()
+static bool decode(VirtualMachine * vm)
+{
+    if (!vm->code && !(vm->code = malloc(((size_t)vm->progsize + 1) * sizeof *vm->code)))
+        return false;
+    if (!vm->image && !(vm->image = malloc((size_t)vm->progsize * sizeof *vm->image)))
+        return false;
+    memcpy(vm->image, vm->mem, (size_t)vm->progsize * sizeof *vm->image);
+    static const unsigned char opindex[26][6] = {
+        [1] = {OP_MOVR, OP_MOVV}, [2] = {OP_ADD, OP_SUB}, [3] = {OP_PUSH, OP_POP},
+        [4] = {OP_JP, OP_JL, OP_CALL}, [5] = {OP_RET}, [6] = {OP_PRINT}, [25] = {[5] = OP_HALT}};
+    for (int addr = 0; addr < vm->progsize; ++addr) {
+        Decoded *d = &vm->code[addr];
+        *d = (Decoded){.op = OP_ERROR, .err = ERR_INVALID_OPCODE, .errpc = addr + 1};
+        const int opcode = vm->mem[addr];
+        if (opcode < OPCODE_MIN || opcode > OPCODE_MAX)
+            continue;
+        const div_t qr = div(opcode, 10);
+        const Instr *instr = &assembly[qr.quot][qr.rem];
+        if (instr->opcode != opcode)
+            continue;
+        d->stackdir = (signed char)instr->stackdir;
+
+        int i = 0, pc = addr + 1, par[MAXPARCOUNT] = {0}, err = ERR_OK;
+        for (int mode = instr->parmode; mode && !err; mode /= 10, ++i) {
+            if (i >= MAXPARCOUNT) {
+                err = ERR_INTERNAL_PARCOUNT;
+                break;
+            }
+            if (pc >= vm->progsize) {
+                err = ERR_PC_OVERFLOW;
+                break;
+            }
+            par[i] = vm->mem[pc++];
+            switch (mode % 10) {
+                case PAR_IMMEDIATE: break;
+                case PAR_REGISTER:
+                    if (par[i] < 0 || par[i] >= vm->regcount)
+                        err = ERR_REGISTER_INDEX;
+                    break;
+                case PAR_ABSOLUTE:
+                    if (par[i] < 0 || par[i] >= vm->progsize)
+                        err = par[i] < 0 ? ERR_PC_UNDERFLOW : ERR_PC_OVERFLOW;
+                    break;
+                default: err = ERR_INTERNAL_PARMODE; break;
+            }
+        }
+        if (err) {
+            d->err = err;
+            d->errpc = pc;
+            continue;
+        }
+
+        d->op = opindex[qr.quot][qr.rem];
+        d->next = pc;
+        switch (d->op) {
+            case OP_MOVR: case OP_ADD: case OP_SUB:
+                d->a = &vm->reg[par[0]];
+                d->b = &vm->reg[par[1]];
+                break;
+            case OP_MOVV:
+                d->a = &vm->reg[par[0]];
+                d->val = par[1];
+                break;
+            case OP_PUSH: case OP_POP: case OP_PRINT:
+                d->a = &vm->reg[par[0]];
+                break;
+            case OP_JP: case OP_CALL:
+                d->val = par[0];
+                break;
+            case OP_JL:
+                d->a = &vm->reg[par[0]];
+                d->b = &vm->reg[par[1]];
+                d->val = par[2];
+                break;
+        }
+    }
+    vm->code[vm->progsize] = (Decoded){.op = OP_END};
+    return true;
+}
+
+// Same as calling tick() up to 'cycles' times (0 = until halted), returns last exit code.
+// Executes pre-decoded records. If program memory was changed since the last
+// decoding, it is decoded again; if that is not possible, falls back to tick().
+static int execute(VirtualMachine * vm, int cycles)
 {
     if (!vm)
         return ERR_NULLPOINTER;
-    int exitcode = 0;
-    while (!vm->halted)
-        exitcode = tick(vm);
+    if (vm->halted)
+        return ERR_OK;
+    if (cycles <= 0)
+        cycles = INT_MAX;
+    const bool stale = !vm->code || !vm->image
+        || memcmp(vm->mem, vm->image, (size_t)vm->progsize * sizeof *vm->mem);
+    if (stale && !decode(vm)) {
+        int exitcode = ERR_OK;
+        for (int i = 0; i < cycles && !vm->halted; ++i)
+            exitcode = tick(vm);
+        return exitcode;
+    }
+
+    static void * const label[] = {
+        [OP_MOVR] = &&movr, [OP_MOVV] = &&movv, [OP_ADD] = &&add, [OP_SUB] = &&sub,
+        [OP_PUSH] = &&push, [OP_POP] = &&pop, [OP_JP] = &&jp, [OP_JL] = &&jl,
+        [OP_CALL] = &&call, [OP_RET] = &&ret, [OP_PRINT] = &&print, [OP_HALT] = &&halt,
+        [OP_ERROR] = &&error, [OP_END] = &&end};
+    const Decoded * const code = vm->code;
+    const Decoded *d;
+    int * const stack = vm->stack;
+    const int stacksize = vm->stacksize, progsize = vm->progsize;
+    int pc = vm->pc, sp = vm->sp, done = 0, failed = 0, exitcode = ERR_OK;
+
+    // Every completed instruction counts as tick and tock, a failed one only as tick
+    #define NEXT(newpc) do { pc = (newpc); ++done; goto dispatch; } while (0)
+    #define FAIL(code, newpc) do { exitcode = (code); pc = (newpc); failed = 1; goto stop; } while (0)
+
+    // Only RET can jump outside the program, other targets were checked by decode()
+    if (pc < 0 || pc > progsize)
+        goto outside;
+dispatch:
+    if (done == cycles)
+        goto pause;
+    d = &code[pc];  // code[progsize] = OP_END
+    goto *label[d->op];
+
+movr:  *d->a = *d->b;  NEXT(d->next);
+movv:  *d->a = d->val; NEXT(d->next);
+add:   *d->a += *d->b; NEXT(d->next);
+sub:   *d->a -= *d->b; NEXT(d->next);
+push:
+    if (sp >= stacksize)
+        FAIL(ERR_STACK_FULL, pc + 1);
+    stack[sp++] = *d->a;
+    NEXT(d->next);
+pop:
+    if (sp <= 0)
+        FAIL(ERR_STACK_EMPTY, pc + 1);
+    *d->a = stack[--sp];
+    NEXT(d->next);
+jp:    NEXT(d->val);
+jl:    NEXT(*d->a < *d->b ? d->val : d->next);
+call:
+    if (sp >= stacksize)
+        FAIL(ERR_STACK_FULL, pc + 1);
+    stack[sp++] = d->next;
+    NEXT(d->val);
+ret:
+    if (sp <= 0)
+        FAIL(ERR_STACK_EMPTY, pc + 1);
+    pc = stack[--sp];
+    ++done;
+    if (pc < 0 || pc > progsize)
+        goto outside;
+    goto dispatch;
+print:
+    vm->retval = *d->a;
+    if (!vm->silent)
+        printf("%d\n", vm->retval);
+    NEXT(d->next);
+halt:
+    pc = d->next;
+    ++done;
+    goto stop;
+error:
+    if (d->stackdir == 1 && sp >= stacksize)
+        FAIL(ERR_STACK_FULL, pc + 1);
+    if (d->stackdir == -1 && sp <= 0)
+        FAIL(ERR_STACK_EMPTY, pc + 1);
+    FAIL(d->err, d->errpc);
+end:
+outside:
+    // pc not in program: fails before the clock cycle starts
+    if (done == cycles)
+        goto pause;
+    exitcode = pc < 0 ? ERR_PC_UNDERFLOW : ERR_PC_OVERFLOW;
+    goto stop;
+
+    #undef NEXT
+    #undef FAIL
+
+stop:
+    vm->halted = true;
+pause:
+    vm->pc = pc;
+    vm->sp = sp;
+    vm->tick += done + failed;
+    vm->tock += done;
     return exitcode;
 }
 
-int main(void)
+static int run(VirtualMachine * vm)
+{
+    return execute(vm, 0);
+}
+
+// Batch mode: all VMs and their memory, stack, registers and decoded
+// instructions in one allocation, so no per-VM malloc and no decoding malloc.
+typedef struct {
+    VirtualMachine *vm;
+    int *exitcode;
+    int count, budget;
+    atomic_int next;
+    void *arena;
+} Pool;
+
+// Pool with one VM per line (lines = count NUL-terminated strings)
+static bool new_pool(Pool * pool, char ** lines, int count, int budget)
+{
+    size_t ncode = 0, nint = 0;
+    for (int i = 0; i < count; ++i) {
+        const int progsize = fieldcount(lines[i]), memsize = progsize ? progsize : MEMORYSIZE;
+        ncode += (size_t)progsize + 1;
+        nint += 2 * (size_t)memsize + STACKSIZE + REGISTERS;
+    }
+    *pool = (Pool){.count = count, .budget = budget};
+    char *arena = calloc(1, (size_t)count * (sizeof *pool->vm + sizeof *pool->exitcode)
+        + ncode * sizeof(Decoded) + nint * sizeof(int));
+    if (!arena)
+        return false;
+    pool->arena = arena;
+    pool->vm = (VirtualMachine *)arena;
+    Decoded *code = (Decoded *)(pool->vm + count);
+    int *mem = (int *)(code + ncode);
+    pool->exitcode = mem + nint;
+
+    for (int i = 0; i < count; ++i) {
+        VirtualMachine *vm = &pool->vm[i];
+        const int progsize = fieldcount(lines[i]), memsize = progsize ? progsize : MEMORYSIZE;
+        vm->mem = mem;
+        vm->image = mem + memsize;
+        vm->stack = mem + 2 * memsize;
+        vm->reg = vm->stack + STACKSIZE;
+        mem = vm->reg + REGISTERS;
+        vm->code = code;
+        code += progsize + 1;
+        vm->memsize = memsize;
+        vm->stacksize = STACKSIZE;
+        vm->regcount = REGISTERS;
+        vm->silent = true;
+        if (!loadprog(vm, lines[i], progsize)) {
+            vm->halted = true;
+            pool->exitcode[i] = ERR_PARSE;
+        } else
+            decode(vm);  // code and image already allocated, can't fail
+    }
+    return true;
+}
+
+static void *poolworker(void *arg)
 {
+    Pool *pool = arg;
+    int first;
+    while ((first = atomic_fetch_add(&pool->next, CHUNK)) < pool->count)
+        for (int i = first; i < first + CHUNK && i < pool->count; ++i) {
+            VirtualMachine *vm = &pool->vm[i];
+            if (vm->halted)
+                continue;  // parse error
+            pool->exitcode[i] = execute(vm, pool->budget);
+            if (!vm->halted)
+                pool->exitcode[i] = ERR_CYCLE_BUDGET;
+        }
+    return NULL;
+}
+
+static int batch(const char * const name, int budget, int nthreads)
+{
+    FILE *f = fopen(name, "rb");
+    if (!f) {
+        fprintf(stderr, "File not found: %s\n", name);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc((size_t)size + 1);
+    char **lines = malloc(((size_t)size / 2 + 1) * sizeof *lines);  // at most 1 line per 2 chars
+    if (!text || !lines || fread(text, 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        free(text);
+        free(lines);
+        return 2;
+    }
+    fclose(f);
+    text[size] = '\0';
+
+    // Non-empty lines as separate strings
+    int count = 0;
+    for (char *c = text; *c; ) {
+        char *eol = c;
+        while (*eol && *eol != '\n' && *eol != '\r')
+            ++eol;
+        const bool more = *eol != '\0';
+        *eol = '\0';
+        if (eol > c)
+            lines[count++] = c;
+        c = more ? eol + 1 : eol;
+    }
+
+    Pool pool;
+    if (!new_pool(&pool, lines, count, budget)) {
+        free(text);
+        free(lines);
+        return 2;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_t tid[MAXTHREADS];
+    int started = 0;
+    for (int i = 1; i < nthreads; ++i)
+        if (!pthread_create(&tid[started], NULL, poolworker, &pool))
+            started++;
+    poolworker(&pool);
+    for (int i = 0; i < started; ++i)
+        pthread_join(tid[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    const double s = (double)(t1.tv_sec - t0.tv_sec) + 1e-9 * (double)(t1.tv_nsec - t0.tv_nsec);
+
+    // Result table
+    long long ticks = 0, tocks = 0;
+    int errcount[ERRCOUNT] = {0};
+    printf("%8s  %-21s %10s %10s %5s %11s\n", "program", "exitcode", "tick", "tock", "pc", "retval");
+    for (int i = 0; i < count; ++i) {
+        const VirtualMachine *vm = &pool.vm[i];
+        const int e = pool.exitcode[i];
+        printf("%8d  %-21s %10d %10d %5d %11d\n", i + 1, errname[e], vm->tick, vm->tock, vm->pc, vm->retval);
+        ticks += vm->tick;
+        tocks += vm->tock;
+        errcount[e]++;
+    }
+    for (size_t i = 0; i < ERRCOUNT; ++i)
+        if (errcount[i])
+            fprintf(stderr, "%-21s : %d\n", errname[i], errcount[i]);
+    fprintf(stderr, "Programs              : %d\n", count);
+    fprintf(stderr, "Threads               : %d\n", started + 1);
+    fprintf(stderr, "Instructions          : %lld (%lld cycles)\n", tocks, ticks);
+    fprintf(stderr, "Time                  : %.3f s\n", s);
+    fprintf(stderr, "Instructions/s        : %.3e\n", s > 0 ? (double)tocks / s : 0);
+
+    free(pool.arena);
+    free(text);
+    free(lines);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && argv[1][0] == '-' && argv[1][1] == 'b') {
+        const int budget = argc > 3 ? atoi(argv[3]) : BUDGET;
+        int nthreads = argc > 4 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (nthreads < 1)
+            nthreads = 1;
+        if (nthreads > MAXTHREADS)
+            nthreads = MAXTHREADS;
+        return batch(argv[2], budget > 0 ? budget : BUDGET, nthreads);
+    }
     VirtualMachine *vm = new_vm(input);  // init
     int exitcode = run(vm);              // print first 10 Fibonacci numbers
     del_vm(&vm);                         // cleanup
@@ -1,10 +1,63 @@
 // Homework assignment posted by /u/ig_grr in /r/cprogramming/
 // https://www.reddit.com/r/cprogramming/comments/1h1xljb/files_in_c/
 // Paraphrased: make a `wc' (the unix tool) clone but also count sentences.
+//
+// Option -c: only count, don't print every word. Regular files are mmap'ed,
+// other input is read in large blocks. Bytes are classified 64 at a time
+// (AVX2 or SSE2 when available) into bitmasks of white space, newlines and
+// sentence ends; words and sentences are counted from the bit transitions.
+// Output is the same as the last line without -c.
+// Mapped files are split into chunks that are counted in parallel; every chunk
+// starts as if after white space, and the chunks are stitched back together
+// with the first byte of each chunk and the last byte of the previous one.
+// Option -b: benchmark counting speed of a file from 1 to all CPUs.
+//
+// Compile: gcc -std=gnu17 -Wall -O3 wc.c -pthread
+// Usage  : wc [-c] [-t threads] [file]    or    wc [-c] [-t threads] < file
+//          wc -b file
 
-#include <stdio.h>   // printf, fopen, fclose, FILE, EOF, NULL, size_t
-#include <ctype.h>   // isspace
-#include <unistd.h>  // isatty, fileno
+#include <stdio.h>      // printf, fopen, fclose, FILE, EOF, NULL, size_t
+#include <stdlib.h>     // atoi, aligned_alloc, free
+#include <string.h>     // strcmp, memcpy
+#include <stdint.h>     // uint64_t
+#include <inttypes.h>   // PRIu64
+#include <stdbool.h>    // bool
+#include <ctype.h>      // isspace
+#include <unistd.h>     // isatty, fileno, read
+#include <sys/stat.h>   // fstat
+#include <sys/mman.h>   // mmap, munmap, madvise
+#include <time.h>       // clock_gettime
+#include <pthread.h>    // pthread_create, pthread_join
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define WC_X86 1
+    #include <immintrin.h>  // _mm256_cmpeq_epi8 etc.
+#else
+    #define WC_X86 0
+#endif
+
+#define READBLOCK (1 << 20)  // read buffer size for non-mappable input
+#define MINCHUNK  (1 << 20)  // don't split into smaller chunks than this
+#define MAXTHREADS 256
+
+// Counting state, carried from one block to the next
+typedef struct {
+    uint64_t words, lines, sents, bytes;
+    bool space;    // last byte was white space (or no bytes yet)
+    bool stop;     // last byte was end of sentence: '.', '!' or '?'
+    bool newline;  // last byte was '\n'
+    bool lead;     // first byte was white space
+} Count;
+
+typedef void (*countfunc_t)(Count *const, const unsigned char *, size_t);
+
+typedef struct {
+    pthread_t tid;
+    countfunc_t count;
+    const unsigned char *data;
+    size_t len;
+    Count c;
+} Chunk;
 
 static void wordflush(char *const buf, size_t *const len)
 {
@@ -13,8 +66,262 @@ static void wordflush(char *const buf, size_t *const len)
     *len = 0;             // no longer inside a word.
 }
 
+// Add block of n <= 64 bytes, given as bitmasks with bit i for byte i
+static inline void addmasks(Count *const c, uint64_t space, uint64_t newline, uint64_t stop, const int n)
+{
+    const uint64_t valid = n == 64 ? ~UINT64_C(0) : (UINT64_C(1) << n) - 1;
+    space &= valid;
+    newline &= valid;
+    stop &= valid;
+    if (!c->bytes)
+        c->lead = space & 1;
+    const uint64_t prevspace = space << 1 | c->space;  // previous byte was white space
+    const uint64_t prevstop  = stop << 1 | c->stop;    // previous byte ended a sentence
+    c->words += (uint64_t)__builtin_popcountll(~space & prevspace & valid);  // word begins
+    c->sents += (uint64_t)__builtin_popcountll(space & prevstop);            // sentence ends
+    c->lines += (uint64_t)__builtin_popcountll(newline);
+    c->bytes += (uint64_t)n;
+    c->space   = space   >> (n - 1) & 1;
+    c->stop    = stop    >> (n - 1) & 1;
+    c->newline = newline >> (n - 1) & 1;
+}
+
+// Up to 64 bytes, one at a time
+static void countscalar(Count *const c, const unsigned char *p, size_t n)
+{
+    for (; n; ) {
+        const int len = n < 64 ? (int)n : 64;
+        uint64_t space = 0, newline = 0, stop = 0;
+        for (int i = 0; i < len; ++i) {
+            const uint64_t bit = UINT64_C(1) << i;
+            if (isspace(p[i]))
+                space |= bit;
+            if (p[i] == '\n')
+                newline |= bit;
+            if (p[i] == '.' || p[i] == '!' || p[i] == '?')
+                stop |= bit;
+        }
+        addmasks(c, space, newline, stop, len);
+        p += len;
+        n -= (size_t)len;
+    }
+}
+
+#if WC_X86
+// Space is ' ' or '\t'..'\r' (9..13) as isspace() in the C locale.
+// Unsigned compare x - 9 <= 4 via min(x - 9, 4) == x - 9.
+#define WC_CLASSIFY(V, SET1, CMPEQ, SUB, MIN, OR, MOVEMASK, S, N, P) { \
+    const __typeof__(V) t = SUB(V, SET1('\t')); \
+    S = (uint32_t)MOVEMASK(OR(CMPEQ(V, SET1(' ')), CMPEQ(MIN(t, SET1(4)), t))); \
+    N = (uint32_t)MOVEMASK(CMPEQ(V, SET1('\n'))); \
+    P = (uint32_t)MOVEMASK(OR(OR(CMPEQ(V, SET1('.')), CMPEQ(V, SET1('!'))), CMPEQ(V, SET1('?')))); \
+}
+
+__attribute__((target("avx2")))
+static void countavx2(Count *const c, const unsigned char *p, size_t n)
+{
+    for (; n >= 64; p += 64, n -= 64) {
+        const __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+        const __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+        uint64_t s0, n0, p0, s1, n1, p1;
+        WC_CLASSIFY(lo, _mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_sub_epi8, _mm256_min_epu8, _mm256_or_si256, _mm256_movemask_epi8, s0, n0, p0);
+        WC_CLASSIFY(hi, _mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_sub_epi8, _mm256_min_epu8, _mm256_or_si256, _mm256_movemask_epi8, s1, n1, p1);
+        addmasks(c, s0 | s1 << 32, n0 | n1 << 32, p0 | p1 << 32, 64);
+    }
+    countscalar(c, p, n);
+}
+
+__attribute__((target("sse2")))
+static void countsse2(Count *const c, const unsigned char *p, size_t n)
+{
+    for (; n >= 64; p += 64, n -= 64) {
+        uint64_t space = 0, newline = 0, stop = 0;
+        for (int i = 0; i < 64; i += 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+            uint64_t s, nl, st;
+            WC_CLASSIFY(v, _mm_set1_epi8, _mm_cmpeq_epi8, _mm_sub_epi8, _mm_min_epu8, _mm_or_si128, _mm_movemask_epi8, s, nl, st);
+            space |= s << i;
+            newline |= nl << i;
+            stop |= st << i;
+        }
+        addmasks(c, space, newline, stop, 64);
+    }
+    countscalar(c, p, n);
+}
+#endif
+
+static countfunc_t countbest(void)
+{
+#if WC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return countavx2;
+    if (__builtin_cpu_supports("sse2"))
+        return countsse2;
+#endif
+    return countscalar;
+}
+
+// Append count b of the bytes that directly follow those of count a
+static void countmerge(Count *const a, const Count *const b)
+{
+    if (!b->bytes)
+        return;
+    if (!a->bytes)
+        a->lead = b->lead;
+    if (!a->space && !b->lead)
+        a->words--;  // one word across the boundary, counted again in b
+    if (a->stop && b->lead)
+        a->sents++;  // sentence end at the boundary, not seen by b
+    a->words += b->words;
+    a->lines += b->lines;
+    a->sents += b->sents;
+    a->bytes += b->bytes;
+    a->space = b->space;
+    a->stop = b->stop;
+    a->newline = b->newline;
+}
+
+static void *chunkworker(void *arg)
+{
+    Chunk *ch = arg;
+    ch->c = (Count){.space = true};
+    ch->count(&ch->c, ch->data, ch->len);
+    return NULL;
+}
+
+// Count data in memory with up to nthreads threads
+static Count countparallel(const countfunc_t count, const unsigned char *data, const size_t size, int nthreads)
+{
+    if ((size_t)nthreads > size / MINCHUNK)
+        nthreads = (int)(size / MINCHUNK);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAXTHREADS)
+        nthreads = MAXTHREADS;
+    Chunk chunk[MAXTHREADS];
+    bool started[MAXTHREADS] = {0};
+    const size_t step = size / (size_t)nthreads & ~(size_t)63;  // whole blocks
+    for (int i = 0; i < nthreads; ++i) {
+        const size_t start = step * (size_t)i;
+        chunk[i] = (Chunk){.count = count, .data = data + start,
+            .len = i < nthreads - 1 ? step : size - start};
+    }
+    for (int i = 1; i < nthreads; ++i)
+        started[i] = !pthread_create(&chunk[i].tid, NULL, chunkworker, &chunk[i]);
+    chunkworker(&chunk[0]);
+    Count c = chunk[0].c;
+    for (int i = 1; i < nthreads; ++i) {
+        if (started[i])
+            pthread_join(chunk[i].tid, NULL);
+        else
+            chunkworker(&chunk[i]);  // run it here instead
+        countmerge(&c, &chunk[i].c);
+    }
+    return c;
+}
+
+// Count whole file: mmap if possible, otherwise read in blocks
+// Returns false on read error
+static bool countfile(FILE *f, Count *const c, const int nthreads)
+{
+    const countfunc_t count = countbest();
+    const int fd = fileno(f);
+    struct stat st;
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        const size_t size = (size_t)st.st_size;
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+        #ifdef MADV_SEQUENTIAL
+            madvise(map, size, MADV_SEQUENTIAL);
+        #endif
+            *c = countparallel(count, map, size, nthreads);
+            munmap(map, size);
+            return true;
+        }
+    }
+    unsigned char *buf = aligned_alloc(64, READBLOCK);
+    if (!buf)
+        return false;
+    ssize_t n;
+    while ((n = read(fd, buf, READBLOCK)) > 0)
+        count(c, buf, (size_t)n);
+    free(buf);
+    return n == 0;
+}
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Counting speed from 1 thread to all CPUs, best of 3 runs each
+static int countbench(FILE *f, const int ncpu)
+{
+    const int fd = fileno(f);
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        fprintf(stderr, "Benchmark needs a non-empty regular file.\n");
+        return 1;
+    }
+    const size_t size = (size_t)st.st_size;
+    unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    const countfunc_t count = countbest();
+    const Count ref = countparallel(countscalar, map, size, 1);  // also pages in the file
+    printf("%"PRIu64" bytes, %s\n", ref.bytes, count == countscalar ? "scalar" : "SIMD");
+    printf("threads   GB/s  speedup\n");
+    double base = 0;
+    int err = 0;
+    for (int t = 1; t <= ncpu; t = t < ncpu && t * 2 > ncpu ? ncpu : t * 2) {
+        double best = 0;
+        for (int run = 0; run < 3; ++run) {
+            const double t0 = seconds();
+            const Count c = countparallel(count, map, size, t);
+            const double dt = seconds() - t0;
+            if (c.words != ref.words || c.lines != ref.lines || c.sents != ref.sents
+                || c.space != ref.space || c.newline != ref.newline)
+                err = 1;
+            if (!best || dt < best)
+                best = dt;
+        }
+        if (t == 1)
+            base = best;
+        printf("%7d %6.2f %8.2f\n", t, best > 0 ? size / best * 1e-9 : 0, best > 0 ? base / best : 0);
+    }
+    munmap(map, size);
+    if (err)
+        fprintf(stderr, "Counts differ from the scalar count!\n");
+    return err;
+}
+
 int main(int argc, char *argv[])
 {
+    bool countonly = false, bench = false;
+    const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = ncpu > 0 ? (int)ncpu : 1;
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1]) {
+        if (!strcmp(argv[1], "-c"))
+            countonly = true;
+        else if (!strcmp(argv[1], "-b"))
+            bench = true;
+        else if (!strcmp(argv[1], "-t") && argc > 2) {
+            nthreads = atoi(argv[2]);
+            --argc;
+            ++argv;
+        } else {
+            fprintf(stderr, "Usage: %s [-c] [-t threads] [file]\n       %s -b file\n", argv[0], argv[0]);
+            return 1;
+        }
+        --argc;
+        ++argv;
+    }
+
     char buf[BUFSIZ];
     FILE *f = NULL;
     if (!isatty(fileno(stdin))) {
@@ -37,9 +344,30 @@ int main(int argc, char *argv[])
     if (!f)
         return 1;
 
-    size_t wordlen = 0;
-    int wordcount = 0, linecount = 0, sentcount = 0;
+    if (bench) {
+        const int err = countbench(f, ncpu > 0 ? (int)ncpu : 1);
+        if (f != stdin)
+            fclose(f);
+        return err;
+    }
 
+    uint64_t wordcount = 0, linecount = 0, sentcount = 0;
+
+    if (countonly) {
+        Count c = {.space = true};
+        const bool ok = countfile(f, &c, nthreads);
+        if (f != stdin)
+            fclose(f);
+        if (!ok)
+            return 1;
+        wordcount = c.words;
+        linecount = c.lines + (c.bytes && !c.newline);  // no closing newline
+        sentcount = c.sents + !c.space;                 // unfinished sentence
+        printf("%"PRIu64" %"PRIu64" %"PRIu64"\n", wordcount, linecount, sentcount);
+        return 0;
+    }
+
+    size_t wordlen = 0;
     int c, prev = EOF;
     while ((c = fgetc(f)) != EOF) {
         if (isspace(c)) {
@@ -70,6 +398,6 @@ int main(int argc, char *argv[])
         ++sentcount;
     }
 
-    printf("%d %d %d\n", wordcount, linecount, sentcount);
+    printf("%"PRIu64" %"PRIu64" %"PRIu64"\n", wordcount, linecount, sentcount);
     return 0;
 }